@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <signal.h>
+
+#include "atheepmgr.h"
+#include "agent.h"
+
+/**
+ * Remote agent, which runs on a target with a HW connector and executes
+ * requests of the agent connector (see con_agent.c) received via stdin or
+ * via a Unix socket. Requests are executed by the local connector and the
+ * chip specific EEPROM and OTP access ops, so the host does not need a round
+ * trip for each register access of the EEPROM or OTP reading sequence.
+ */
+
+#define AGENT_BUF_SZ		(AGENT_NUM_MAX * 3 * sizeof(uint32_t))
+
+static volatile sig_atomic_t agent_stop;
+
+static void agent_sighandler(int signum)
+{
+	agent_stop = 1;
+}
+
+static bool agent_write_all(int fd, const void *buf, size_t len)
+{
+	ssize_t res;
+
+	while (len) {
+		res = write(fd, buf, len);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return false;
+		buf += res;
+		len -= res;
+	}
+
+	return true;
+}
+
+static size_t agent_req_plen(const struct agent_req *req)
+{
+	unsigned int num = le16toh(req->num);
+
+	switch (req->op) {
+	case AGENT_OP_REG_READ:
+		return num * sizeof(uint32_t);
+	case AGENT_OP_REG_WRITE:
+		return num * 2 * sizeof(uint32_t);
+	case AGENT_OP_REG_RMW:
+		return num * 3 * sizeof(uint32_t);
+	case AGENT_OP_WAIT:
+		return 3 * sizeof(uint32_t);
+	case AGENT_OP_EEP_WRITE:
+		return num * sizeof(uint16_t);
+	}
+
+	return 0;
+}
+
+/* Execute request, returns status and fills response payload */
+static int agent_exec(struct atheepmgr *aem, const struct agent_req *req,
+		      const void *in, void *out, uint32_t *olen)
+{
+	const unsigned int num = le16toh(req->num);
+	const uint32_t addr = le32toh(req->addr);
+	const uint32_t *iw = in;
+	const uint16_t *ih = in;
+	uint32_t *ow = out;
+	uint16_t *oh = out;
+	uint8_t *ob = out;
+	unsigned int i;
+
+	*olen = 0;
+
+	switch (req->op) {
+	case AGENT_OP_HELLO:
+		ow[0] = htole32(AGENT_PROTO_VER);
+		*olen = sizeof(uint32_t);
+		break;
+
+	case AGENT_OP_REG_READ:
+		for (i = 0; i < num; ++i)
+			ow[i] = htole32(REG_READ(le32toh(iw[i])));
+		*olen = num * sizeof(uint32_t);
+		break;
+
+	case AGENT_OP_REG_BULK:
+		hw_reg_bulk_read(aem, addr, ow, num);
+		for (i = 0; i < num; ++i)
+			ow[i] = htole32(ow[i]);
+		*olen = num * sizeof(uint32_t);
+		break;
+
+	case AGENT_OP_REG_WRITE:
+		for (i = 0; i < num; ++i)
+			REG_WRITE(le32toh(iw[i * 2]), le32toh(iw[i * 2 + 1]));
+		break;
+
+	case AGENT_OP_REG_RMW:
+		for (i = 0; i < num; ++i)
+			REG_RMW(le32toh(iw[i * 3]), le32toh(iw[i * 3 + 1]),
+				le32toh(iw[i * 3 + 2]));
+		break;
+
+	case AGENT_OP_WAIT:
+		if (!hw_wait(aem, addr, le32toh(iw[0]), le32toh(iw[1]),
+			     le32toh(iw[2])))
+			return -ETIMEDOUT;
+		break;
+
+	case AGENT_OP_EEP_READ:
+		if (!aem->eep)
+			return -EOPNOTSUPP;
+		for (i = 0; i < num; ++i) {
+			if (!aem->eep->read(aem, addr + i, &oh[i]))
+				return -EIO;
+			oh[i] = htole16(oh[i]);
+		}
+		*olen = num * sizeof(uint16_t);
+		break;
+
+	case AGENT_OP_EEP_WRITE:
+		if (!aem->eep || !aem->eep->write)
+			return -EOPNOTSUPP;
+		for (i = 0; i < num; ++i)
+			if (!aem->eep->write(aem, addr + i, le16toh(ih[i])))
+				return -EIO;
+		break;
+
+	case AGENT_OP_EEP_LOCK:
+		hw_eeprom_lock(aem, addr);
+		break;
+
+	case AGENT_OP_OTP_ENABLE:
+		if (!hw_otp_enable(aem, addr))
+			return -EIO;
+		break;
+
+	case AGENT_OP_OTP_READ:
+		if (!aem->otp)
+			return -EOPNOTSUPP;
+		for (i = 0; i < num; ++i)
+			if (!aem->otp->read(aem, addr + i, &ob[i]))
+				return -EIO;
+		*olen = num;
+		break;
+
+	default:
+		return -EOPNOTSUPP;
+	}
+
+	return 0;
+}
+
+static int agent_serve(struct atheepmgr *aem, int in_fd, int out_fd)
+{
+	struct agent_resp *resp;
+	struct agent_req req;
+	unsigned long nreqs = 0;
+	uint8_t *ibuf, *obuf;
+	uint32_t olen;
+	size_t plen;
+	FILE *in;
+	int ret = 0;
+
+	in = fdopen(dup(in_fd), "r");
+	ibuf = malloc(AGENT_BUF_SZ);
+	obuf = malloc(sizeof(*resp) + AGENT_BUF_SZ);
+	if (!in || !ibuf || !obuf) {
+		fprintf(stderr, "agent: unable to allocate buffers\n");
+		ret = -ENOMEM;
+		goto exit;
+	}
+	resp = (struct agent_resp *)obuf;
+
+	while (!agent_stop && fread(&req, sizeof(req), 1, in) == 1) {
+		if (le16toh(req.num) > AGENT_NUM_MAX) {
+			fprintf(stderr, "agent: too many items (%u) in request\n",
+				le16toh(req.num));
+			ret = -EPROTO;
+			break;
+		}
+		plen = agent_req_plen(&req);
+		if (plen && fread(ibuf, plen, 1, in) != 1)
+			break;
+
+		resp->status = htole32(agent_exec(aem, &req, ibuf,
+						  obuf + sizeof(*resp), &olen));
+		resp->len = htole32(olen);
+		nreqs++;
+
+		if (req.op == AGENT_OP_REG_WRITE || req.op == AGENT_OP_REG_RMW)
+			continue;	/* Posted request */
+
+		if (!agent_write_all(out_fd, obuf, sizeof(*resp) + olen)) {
+			fprintf(stderr, "agent: unable to send response: %s\n",
+				strerror(errno));
+			ret = -EIO;
+			break;
+		}
+	}
+
+	if (aem->verbose)
+		fprintf(stderr, "agent: served %lu request(s)\n", nreqs);
+
+exit:
+	free(obuf);
+	free(ibuf);
+	if (in)
+		fclose(in);
+
+	return ret;
+}
+
+static int agent_serve_socket(struct atheepmgr *aem, const char *path)
+{
+	int fd, cfd, ret = 0;
+
+	fd = server_listen(path, 1);
+	if (fd < 0)
+		return fd;
+
+	while (!agent_stop) {
+		cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Unable to accept connection: %s\n",
+				strerror(errno));
+			ret = -errno;
+			break;
+		}
+		agent_serve(aem, cfd, cfd);	/* Keep serving on errors */
+		close(cfd);
+	}
+
+	unlink(path);
+	close(fd);
+
+	return ret;
+}
+
+int agent_run(struct atheepmgr *aem, int argc, char *argv[])
+{
+	struct sigaction sa;
+	int out_fd, ret;
+
+	hw_eeprom_set_ops(aem);
+	hw_otp_set_ops(aem);
+
+	/* No SA_RESTART, so signals are able to interrupt I/O */
+	memset(&sa, 0x00, sizeof(sa));
+	sa.sa_handler = agent_sighandler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (argc > 0)
+		return agent_serve_socket(aem, argv[0]);
+
+	/* Keep stdout for responses only, other output goes to stderr */
+	fflush(stdout);
+	out_fd = dup(STDOUT_FILENO);
+	if (out_fd < 0) {
+		fprintf(stderr, "Unable to duplicate output descriptor: %s\n",
+			strerror(errno));
+		return -errno;
+	}
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+
+	ret = agent_serve(aem, STDIN_FILENO, out_fd);
+
+	close(out_fd);
+
+	return ret;
+}
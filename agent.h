@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef AGENT_H
+#define AGENT_H
+
+/**
+ * Remote agent protocol. The host sends requests, each request is a fixed
+ * size header optionally followed by a payload. Posted requests (registers
+ * writes) have no response, so they are queued by the host and sent in a
+ * batch together with the next request, which needs a response. Any other
+ * request is answered with a fixed size response header followed by
+ * a payload. All fields and payload words are Little-endian.
+ *
+ * Request payload / response payload:
+ *   HELLO:     - / version (32 bits)
+ *   REG_READ:  <num> addresses / <num> values (32 bits each)
+ *   REG_BULK:  - / <num> values of consecutive registers from <addr>
+ *   REG_WRITE: <num> pairs of address and value, posted
+ *   REG_RMW:   <num> triples of address, set and clear masks, posted
+ *   WAIT:      mask, value and timeout (us) of the <addr> register / -
+ *   EEP_READ:  - / <num> 16-bits words from <addr> word
+ *   EEP_WRITE: <num> 16-bits words to be written from <addr> word / -
+ *   EEP_LOCK:  - (<addr> is the lock flag) / -
+ *   OTP_ENABLE: - (<addr> is the enable flag) / -
+ *   OTP_READ:  - / <num> bytes from <addr>
+ */
+
+#define AGENT_PROTO_VER		1
+
+#define AGENT_NUM_MAX		4096	/* Max items in a request */
+
+enum agent_op {
+	AGENT_OP_HELLO = 1,
+	AGENT_OP_REG_READ,
+	AGENT_OP_REG_BULK,
+	AGENT_OP_REG_WRITE,
+	AGENT_OP_REG_RMW,
+	AGENT_OP_WAIT,
+	AGENT_OP_EEP_READ,
+	AGENT_OP_EEP_WRITE,
+	AGENT_OP_EEP_LOCK,
+	AGENT_OP_OTP_ENABLE,
+	AGENT_OP_OTP_READ,
+};
+
+struct agent_req {
+	uint8_t op;
+	uint8_t __pad;
+	uint16_t num;
+	uint32_t addr;
+} __attribute__ ((packed));
+
+struct agent_resp {
+	int32_t status;		/* Zero or negative errno */
+	uint32_t len;		/* Payload length, bytes */
+} __attribute__ ((packed));
+
+#endif /* AGENT_H */
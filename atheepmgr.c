@@ -453,6 +453,9 @@ static int act_eep_update(struct atheepmgr *aem, int argc, char *argv[])
 
 	EEP_LOCK();
 
+	/* Subsequent loads should see what was actually stored */
+	hw_eeprom_shadow_invalidate(aem);
+
 	return res ? 0 : -EIO;
 }
 
@@ -471,7 +474,7 @@ static int act_eep_tpl_export(struct atheepmgr *aem, int argc, char *argv[])
 	}
 
 	data_len = eepmap->unpacked_buf_sz;
-	if (!eepmap->templates || !data_len) {
+	if ((!eepmap->templates && !aem->tplpack) || !data_len) {
 		fprintf(stderr, "EEPROM map does not have any templates\n");
 		return -EOPNOTSUPP;
 	}
@@ -493,7 +496,9 @@ static int act_eep_tpl_export(struct atheepmgr *aem, int argc, char *argv[])
 		if (tpl->id == tplid || strcasecmp(tpl->name, argv[0]) == 0)
 			break;
 	}
-	if (!tpl->name) {
+	if (!tpl->name)
+		tpl = tplpack_lookup(aem, eepmap, tplid, argv[0]);
+	if (!tpl || !tpl->name) {
 		fprintf(stderr, "Unknown template -- %s\n", argv[0]);
 		return -EINVAL;
 	}
@@ -515,11 +520,131 @@ static int act_eep_tpl_export(struct atheepmgr *aem, int argc, char *argv[])
 	return res == data_len ? 0 : -EIO;
 }
 
+/**
+ * Estimate a size of the block compressed data that restores the data from the
+ * template. Each block consists of a 2 octets header (offset from the previous
+ * block end and the block length, both are limited to 255) followed by data.
+ * So small gaps between differing regions are cheaper to be included to the
+ * previous block than to start a new one.
+ */
+static size_t tpl_match_flush_blk(size_t *spot, size_t start, size_t end)
+{
+	size_t size = 0, gap = start - *spot, len = end - start;
+
+	for (; gap > 255; gap -= 255)	/* Empty blocks to skip a long gap */
+		size += 2;
+	size += 2 * ((len + 254) / 255) + len;
+	*spot = end;
+
+	return size;
+}
+
+static size_t tpl_match_blk_size(const uint8_t *data, const uint8_t *tpl,
+				 size_t len, unsigned int *regions)
+{
+	size_t i, start, bstart = 0, bend = 0, spot = 0, size = 0;
+
+	*regions = 0;
+
+	for (i = 0; i < len; ++i) {
+		if (data[i] == tpl[i])
+			continue;
+		for (start = i; i < len && data[i] != tpl[i]; ++i);
+		++*regions;
+		if (bend && start - bend <= 2) {
+			bend = i;
+			continue;
+		}
+		if (bend)
+			size += tpl_match_flush_blk(&spot, bstart, bend);
+		bstart = start;
+		bend = i;
+	}
+	if (bend)
+		size += tpl_match_flush_blk(&spot, bstart, bend);
+
+	return size;
+}
+
+static int act_eep_tpl_match(struct atheepmgr *aem, int argc, char *argv[])
+{
+	const struct eepmap *eepmap = aem->eepmap;
+	const struct eeptemplate *tpl, *best = NULL;
+	size_t diff, bound, data_len = aem->unpacked_len;
+	const uint8_t *data = aem->unpacked_buf;
+	unsigned int regions;
+	int pass;
+
+	if (!eepmap->templates || !eepmap->unpacked_buf_sz) {
+		fprintf(stderr, "EEPROM map does not have any templates\n");
+		return -EOPNOTSUPP;
+	}
+
+	/* Uncompressed data (e.g. blob) are kept in the EEPROM buffer as-is */
+	if (!data_len && aem->eep_len * 2 >= eepmap->unpacked_buf_sz) {
+		data = (const uint8_t *)aem->eep_buf;
+		data_len = eepmap->unpacked_buf_sz;
+	}
+	if (!data_len) {
+		fprintf(stderr, "There are no unpacked data to compare with templates\n");
+		return -ENOENT;
+	}
+
+	/**
+	 * Use the best result as a bound for the next templates, so we do not
+	 * waste time on a full comparison with the clearly distant templates.
+	 * External templates (if any) are checked on the second pass.
+	 */
+	bound = data_len;
+	for (pass = 0; pass < 2; ++pass) {
+		int i;
+
+		for (i = 0; ; ++i) {
+			if (pass == 0)
+				tpl = eepmap->templates[i].name ?
+				      &eepmap->templates[i] : NULL;
+			else
+				tpl = tplpack_nth(aem, eepmap, i);
+			if (!tpl)
+				break;
+
+			diff = memdiff(data, tpl->data, data_len, bound);
+			if (aem->verbose) {
+				if (diff > bound)
+					printf("%20s %3d: >%zu bytes differ\n",
+					       tpl->name, tpl->id, bound);
+				else
+					printf("%20s %3d: %zu bytes differ\n",
+					       tpl->name, tpl->id, diff);
+			}
+			if (diff <= bound && (!best || diff < bound)) {
+				best = tpl;
+				bound = diff;
+			}
+		}
+	}
+
+	if (!best) {
+		fprintf(stderr, "Unable to find a template to compare with\n");
+		return -ENOENT;
+	}
+
+	printf("Nearest template: %s (id %d)\n", best->name, best->id);
+	printf("Differing bytes: %zu of %zu\n", bound, data_len);
+	/* Packed size includes 4 octets header and 2 octets checksum */
+	diff = tpl_match_blk_size(data, best->data, data_len, &regions);
+	printf("Differing regions: %u\n", regions);
+	printf("Estimated block compressed size: %zu bytes\n", 4 + diff + 2);
+
+	return 0;
+}
+
 static int act_gpio_dump(struct atheepmgr *aem, int argc, char *argv[])
 {
 #define FOR_EACH_GPIO(_caption)				\
 		printf("%20s:", _caption);		\
 		for (i = 0; i < aem->gpio_num; ++i)
+	struct gpio_snapshot snap;
 	int i;
 
 	if (!aem->gpio) {
@@ -527,22 +652,24 @@ static int act_gpio_dump(struct atheepmgr *aem, int argc, char *argv[])
 		return -EOPNOTSUPP;
 	}
 
+	aem->gpio->snapshot(aem, &snap);
+
 	FOR_EACH_GPIO("GPIO #")
 		printf(" %-3u", i);
 	printf("\n");
 	FOR_EACH_GPIO("Direction")
-		printf(" %-3s", aem->gpio->dir_get_str(aem, i));
+		printf(" %-3s", snap.dir_str[i]);
 	printf("\n");
-	if (aem->gpio->out_mux_get_str) {
+	if (snap.out_mux_str[0]) {
 		FOR_EACH_GPIO("Output mux")
-			printf(" %-3s", aem->gpio->out_mux_get_str(aem, i));
+			printf(" %-3s", snap.out_mux_str[i]);
 		printf("\n");
 	}
 	FOR_EACH_GPIO("Input value")
-		printf(" %c  ", aem->gpio->input_get(aem, i) ? '1' : ' ');
+		printf(" %c  ", snap.input & BIT(i) ? '1' : ' ');
 	printf("\n");
 	FOR_EACH_GPIO("Output value")
-		printf(" %c  ", aem->gpio->output_get(aem, i) ? '1' : ' ');
+		printf(" %c  ", snap.output & BIT(i) ? '1' : ' ');
 	printf("\n");
 
 	return 0;
@@ -604,12 +731,237 @@ static int act_reg_write(struct atheepmgr *aem, int argc, char *argv[])
 	return 0;
 }
 
+/**
+ * Registers snapshot consists of two files: the raw data file with register
+ * values as Little-endian 32-bits words and the index file (data file name
+ * with the '.idx' suffix) with a line per registers window in form of:
+ * "<first register address> <registers number> <data offset>".
+ */
+static int regsnap_idx_fname(char *buf, size_t bufsz, const char *fname)
+{
+	if (snprintf(buf, bufsz, "%s.idx", fname) >= bufsz) {
+		fprintf(stderr, "Too long snapshot file name -- %s\n", fname);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static uint32_t *regsnap_load(const char *fname, uint32_t *start,
+			      unsigned int *num)
+{
+	unsigned int addr, cnt, off, i;
+	uint32_t *vals = NULL;
+	char idxfname[0x100];
+	long size;
+	FILE *fp;
+
+	if (regsnap_idx_fname(idxfname, sizeof(idxfname), fname))
+		return NULL;
+
+	fp = fopen(idxfname, "r");
+	if (!fp) {
+		fprintf(stderr, "Unable to open index file %s: %s\n", idxfname,
+			strerror(errno));
+		return NULL;
+	}
+	i = fscanf(fp, "%x %x %x", &addr, &cnt, &off);
+	fclose(fp);
+	if (i != 3 || !cnt || addr % 4 != 0 ||
+	    (uint64_t)addr + (uint64_t)(cnt - 1) * 4 > UINT32_MAX) {
+		fprintf(stderr, "Invalid snapshot index file %s\n", idxfname);
+		return NULL;
+	}
+
+	fp = fopen(fname, "rb");
+	if (!fp) {
+		fprintf(stderr, "Unable to open snapshot file %s: %s\n", fname,
+			strerror(errno));
+		return NULL;
+	}
+	if (fseek(fp, 0, SEEK_END) != 0 || (size = ftell(fp)) < 0 ||
+	    off > size || cnt > (size - off) / sizeof(*vals)) {
+		fprintf(stderr, "Snapshot file %s is shorter than its index specifies\n",
+			fname);
+		goto err;
+	}
+	vals = malloc(cnt * sizeof(*vals));
+	if (!vals) {
+		fprintf(stderr, "Unable to allocate memory for registers values\n");
+		goto err;
+	}
+	if (fseek(fp, off, SEEK_SET) != 0 ||
+	    fread(vals, sizeof(*vals), cnt, fp) != cnt) {
+		fprintf(stderr, "Unable to read snapshot file %s\n", fname);
+		goto err;
+	}
+	fclose(fp);
+
+	for (i = 0; i < cnt; ++i)
+		vals[i] = le32toh(vals[i]);
+	*start = addr;
+	*num = cnt;
+
+	return vals;
+
+err:
+	free(vals);
+	fclose(fp);
+
+	return NULL;
+}
+
+static int act_reg_dump(struct atheepmgr *aem, int argc, char *argv[])
+{
+	unsigned long start, end;
+	unsigned int i, num;
+	char idxfname[0x100];
+	uint32_t *vals;
+	FILE *fp = NULL;
+	char *endp;
+	int ret;
+
+	if (argc < 3) {
+		fprintf(stderr, "Registers range and (or) output file are not specified, aborting\n");
+		return -EINVAL;
+	}
+
+	errno = 0;
+
+	start = strtoul(argv[0], &endp, 16);
+	if (errno != 0 || *endp != '\0' || start % 4 != 0) {
+		fprintf(stderr, "Invalid first register address -- %s\n",
+			argv[0]);
+		return -EINVAL;
+	}
+
+	end = strtoul(argv[1], &endp, 16);
+	if (errno != 0 || *endp != '\0' || end % 4 != 0 || end < start ||
+	    end > UINT32_MAX) {
+		fprintf(stderr, "Invalid last register address -- %s\n",
+			argv[1]);
+		return -EINVAL;
+	}
+
+	ret = regsnap_idx_fname(idxfname, sizeof(idxfname), argv[2]);
+	if (ret)
+		return ret;
+
+	num = (end - start) / sizeof(uint32_t) + 1;
+	vals = malloc(num * sizeof(*vals));
+	if (!vals) {
+		fprintf(stderr, "Unable to allocate memory for registers values\n");
+		return -ENOMEM;
+	}
+
+	hw_reg_bulk_read(aem, start, vals, num);
+	for (i = 0; i < num; ++i)
+		vals[i] = htole32(vals[i]);
+
+	ret = -EIO;
+	fp = fopen(argv[2], "wb");
+	if (!fp) {
+		fprintf(stderr, "Unable to open output file %s: %s\n", argv[2],
+			strerror(errno));
+		goto exit;
+	}
+	if (fwrite(vals, sizeof(*vals), num, fp) != num) {
+		fprintf(stderr, "Unable to write registers values\n");
+		goto exit;
+	}
+	fclose(fp);
+
+	fp = fopen(idxfname, "w");
+	if (!fp) {
+		fprintf(stderr, "Unable to open index file %s: %s\n", idxfname,
+			strerror(errno));
+		goto exit;
+	}
+	if (fprintf(fp, "0x%08lx 0x%08x 0x%08x\n", start, num, 0) < 0) {
+		fprintf(stderr, "Unable to write index file\n");
+		goto exit;
+	}
+
+	if (aem->verbose)
+		printf("Saved %u registers 0x%08lx...0x%08lx to %s\n", num,
+		       start, end, argv[2]);
+
+	ret = 0;
+
+exit:
+	if (fp)
+		fclose(fp);
+	free(vals);
+
+	return ret;
+}
+
+static int act_reg_diff(struct atheepmgr *aem, int argc, char *argv[])
+{
+	uint32_t *vals1 = NULL, *vals2 = NULL, start1, start2, end1, end2;
+	uint32_t first, last, addr;
+	unsigned int num1, num2, num, i, diff = 0;
+	int ret = -EINVAL;
+
+	if (argc < 2) {
+		fprintf(stderr, "Snapshot files are not specified, aborting\n");
+		return -EINVAL;
+	}
+
+	vals1 = regsnap_load(argv[0], &start1, &num1);
+	if (!vals1)
+		goto exit;
+	vals2 = regsnap_load(argv[1], &start2, &num2);
+	if (!vals2)
+		goto exit;
+
+	/* Compare only the registers range that is covered by both */
+	/* NB: loading guarantees aligned and not wrapped ranges */
+	end1 = start1 + (num1 - 1) * 4;
+	end2 = start2 + (num2 - 1) * 4;
+	first = start1 > start2 ? start1 : start2;
+	last = end1 < end2 ? end1 : end2;
+	if (first > last) {
+		fprintf(stderr, "Snapshots have no common registers\n");
+		goto exit;
+	}
+
+	num = (last - first) / 4 + 1;
+	for (i = 0; i < num; ++i) {
+		uint32_t v1, v2;
+
+		addr = first + i * 4;
+		v1 = vals1[(addr - start1) / 4];
+		v2 = vals2[(addr - start2) / 4];
+		if (v1 == v2)
+			continue;
+		printf("0x%08x: 0x%08x -> 0x%08x (changed bits 0x%08x)\n",
+		       addr, v1, v2, v1 ^ v2);
+		diff++;
+	}
+	printf("Differing registers: %u of %u\n", diff, num);
+
+	ret = 0;
+
+exit:
+	free(vals1);
+	free(vals2);
+
+	return ret;
+}
+
 #define ACT_F_DATA	(1 << 0)	/* Action will interact with EEPROM/OTP data */
 #define ACT_F_HW	(1 << 1)	/* Action require direct HW access */
 #define ACT_F_AUTONOMOUS (1 << 2)	/* Action do not require input data or HW */
 #define ACT_F_RAW_EEP	(1 << 3)	/* Action needs only raw EEPROM contents */
 #define ACT_F_RAW_OTP	(1 << 4)	/* Action needs only raw OTP contents */
 #define ACT_F_RAW_DATA	(ACT_F_RAW_EEP | ACT_F_RAW_OTP)
+#define ACT_F_MODIFY	(1 << 5)	/* Action modifies EEPROM contents */
+#define ACT_F_SESSION	(1 << 6)	/* Action runs other actions on demand */
+#define ACT_F_STANDALONE (1 << 7)	/* Action needs neither EEPROM map nor con */
+
+static int act_serve(struct atheepmgr *aem, int argc, char *argv[]);
+static int act_script(struct atheepmgr *aem, int argc, char *argv[]);
 
 static const struct action {
 	const char *name;
@@ -643,11 +995,15 @@ static const struct action {
 	}, {
 		.name = "update",
 		.func = act_eep_update,
-		.flags = ACT_F_DATA,
+		.flags = ACT_F_DATA | ACT_F_MODIFY,
 	}, {
 		.name = "templateexport",
 		.func = act_eep_tpl_export,
 		.flags = ACT_F_AUTONOMOUS,
+	}, {
+		.name = "templatematch",
+		.func = act_eep_tpl_match,
+		.flags = ACT_F_DATA,
 	}, {
 		.name = "gpiodump",
 		.func = act_gpio_dump,
@@ -660,10 +1016,38 @@ static const struct action {
 		.name = "regwrite",
 		.func = act_reg_write,
 		.flags = ACT_F_HW,
+	}, {
+		.name = "regdump",
+		.func = act_reg_dump,
+		.flags = ACT_F_HW,
+	}, {
+		.name = "regdiff",
+		.func = act_reg_diff,
+		.flags = ACT_F_STANDALONE,
+	}, {
+		.name = "watch",
+		.func = watch_run,
+		.flags = ACT_F_HW,
+	}, {
+		.name = "scan",
+		.func = scan_run,
+		.flags = ACT_F_STANDALONE,
+	}, {
+		.name = "agent",
+		.func = agent_run,
+		.flags = ACT_F_HW,
+	}, {
+		.name = "serve",
+		.func = act_serve,
+		.flags = ACT_F_SESSION,
+	}, {
+		.name = "script",
+		.func = act_script,
+		.flags = ACT_F_SESSION,
 	}
 };
 
-#define CON_USAGE_FILE		"-F <eepdump>"
+#define CON_USAGE_FILE		"-F <eepdump> | -I <infd>[:<outfd>] | -R <path>[:<off>[:<len>]] | -B <file>[:<board>] | -N <agent>"
 #if defined(CONFIG_CON_MEM)
 #define CON_USAGE_MEM		" | -M <ioaddr>"
 #define CON_OPTSTR_MEM		"M:"
@@ -686,14 +1070,14 @@ static const struct action {
 #define CON_OPTSTR_DRIVER	""
 #endif
 
-#define CON_OPTSTR	"F:" CON_OPTSTR_MEM CON_OPTSTR_PCI CON_OPTSTR_DRIVER
+#define CON_OPTSTR	"F:I:R:B:N:" CON_OPTSTR_MEM CON_OPTSTR_PCI CON_OPTSTR_DRIVER
 #if defined(CONFIG_CON_MEM) || defined(CONFIG_CON_PCI) || defined(CONFIG_CON_DRIVER)
 #define CON_USAGE	"{" CON_USAGE_FILE CON_USAGE_MEM CON_USAGE_PCI CON_USAGE_DRIVER "}"
 #else
 #define CON_USAGE	CON_USAGE_FILE
 #endif
 
-static const char *optstr = CON_OPTSTR "ht:v";
+static const char *optstr = CON_OPTSTR "C:E:hL:T:t:v";
 
 static int strptrcmp(const void *a, const void *b)
 {
@@ -795,6 +1179,7 @@ static void usage_eepmap(struct atheepmgr *aem, const struct eepmap *eepmap)
 		printf("%18sKnown EEPROM data templates:\n", "");
 		for (tpl = eepmap->templates; tpl->name; ++tpl)
 			printf("%20s%d: %s\n", "", tpl->id, tpl->name);
+		tplpack_list(aem, eepmap);
 	}
 }
 
@@ -809,12 +1194,26 @@ static void usage(struct atheepmgr *aem, char *name)
 		"Copyright (c) 2013-2021, Sergey Ryazanov <ryazanov.s.a@gmail.com>\n"
 		"\n"
 		"Usage:\n"
-		"  %s " CON_USAGE " [-t <eepmap>] [<action> [<actarg>]]\n"
+		"  %s " CON_USAGE " [-t <eepmap>] [-T <tplpack>] [-C <cache>] [-E <num>] [-L <ms>] [<action> [<actarg>]]\n"
 		"or\n"
 		"  %s -h\n"
 		"\n"
 		"Options:\n"
 		"  -F <eepdump>    Read EEPROM dump from <eepdump> file.\n"
+		"  -I <infd>[:<outfd>] Read EEPROM dump from the <infd> file descriptor ('-'\n"
+		"                  for stdin) and, if <outfd> is specified, write the dump\n"
+		"                  (possibly updated) to the <outfd> descriptor on exit.\n"
+		"  -R <path>[:<off>[:<len>]] Use a <len> bytes long window at <off> offset of\n"
+		"                  the <path> MTD device (e.g. /dev/mtd2) or the flash image\n"
+		"                  file as EEPROM. Modified erase blocks are rewritten on exit.\n"
+		"  -B <file>[:<board>] Use board data from the ath10k board container <file>\n"
+		"                  (board-2.bin). <board> is a board name, a board index or\n"
+		"                  'all' (default) to run the action for each board in turn.\n"
+		"                  Use -v to see the boards index.\n"
+		"  -N <agent>      Interact with card via a remote agent (see the 'agent'\n"
+		"                  action). <agent> is either a pair of descriptors in form\n"
+		"                  <infd>:<outfd> (e.g. pipes of a serial console session) or\n"
+		"                  a path of the Unix socket the agent listens on.\n"
 #if defined(CONFIG_CON_MEM)
 		"  -M <ioaddr>     Interact with card via /dev/mem by mapping card I/O memory\n"
 		"                  at <ioaddr> to the process.\n"
@@ -832,6 +1231,7 @@ static void usage(struct atheepmgr *aem, char *name)
 #if defined(__linux__)
 		"                  <dev> could be specified as a cfg80211 phy (e.g. phy0, phy1)\n"
 		"                  or as a network device/interface (e.g. wlan0, wlan1)\n"
+		"                  or as a path to a directory with driver debug files.\n"
 #endif
 #endif
 		"  -t <eepmap>     Override EEPROM map type (see below), this option is required\n"
@@ -845,6 +1245,22 @@ static void usage(struct atheepmgr *aem, char *name)
 		"                  shure about an exact chip type. So you could check PCI Id with\n"
 		"                  help of pciconf(8)/lspci(8)/pcidump(8) utility and then use\n"
 		"                  obtained identifier to specify chip (and EEPROM map) type.\n"
+		"  -T <tplpack>    Load additional EEPROM data templates from the <tplpack>\n"
+		"                  templates pack file. External templates are used to unpack\n"
+		"                  compressed EEPROM data when a referenced template is not a\n"
+		"                  builtin one, and could be exported like builtin ones.\n"
+		"  -C <cache>      Remember in the <cache> file per device the data source\n"
+		"                  (and the data base address), which succeeded, and try it\n"
+		"                  first next time to avoid probing of absent sources. Device\n"
+		"                  is identified by the connector argument, EEPROM map and\n"
+		"                  chip revision. Cache is used with HW connectors only.\n"
+		"  -E <num>        Consider the device dead after <num> I/O errors (all-ones\n"
+		"                  reads, operation timeouts, connector errors) and fail any\n"
+		"                  further access immediately. Default is %d, 0 disables.\n"
+		"  -L <ms>         Abort device access if the whole operation is not finished\n"
+		"                  in <ms> milliseconds. By default there is no deadline.\n"
+		"                  In the session mode both the errors budget and the\n"
+		"                  deadline are applied to each request separately.\n"
 		"  -v              Be verbose. I.e. print detailed help message, log action\n"
 		"                  stages, print all EEPROM data including unused parameters.\n"
 		"  -h              Print this cruft. Use -v option to see more details.\n"
@@ -854,7 +1270,7 @@ static void usage(struct atheepmgr *aem, char *name)
 		"  <actarg>        Action argument if the action accepts any (see details below\n"
 		"                  in the detailed actions list).\n"
 		"\n",
-		name, name
+		name, name, AH_ERR_BUDGET
 	);
 
 	if (aem->verbose) {
@@ -886,9 +1302,50 @@ static void usage(struct atheepmgr *aem, char *name)
 			"                  supported parameters list below.\n"
 			"  templateexport <name-or-id> <file> Export template specified by Name or by Id\n"
 			"                  to the file <file>.\n"
+			"  templatematch   Compare unpacked EEPROM data with each known template and\n"
+			"                  report the nearest one, a number of differing bytes and\n"
+			"                  regions, and an estimated size of the compressed data.\n"
 			"  gpiodump        Dump GPIO lines state to the terminal.\n"
 			"  regread <addr>  Read register at address <addr> and print it value.\n"
 			"  regwrite <addr> <val> Write value <val> to the register at address <addr>.\n"
+			"  regdump <start> <end> <file> Save values of registers from <start> to <end>\n"
+			"                  inclusive to the file <file> as Little-endian 32-bits words.\n"
+			"                  Also the '<file>.idx' index file with the first register\n"
+			"                  address, registers number and data offset is written.\n"
+			"  regdiff <file1> <file2> Compare two registers snapshots, that were saved by\n"
+			"                  the 'regdump' action, and print differing registers.\n"
+			"  watch [rate=<hz>] [ring=<num>] [time=<sec>] <item> [<item> ...]\n"
+			"                  Sample registers and/or GPIO inputs periodically and record\n"
+			"                  their changes with timestamps. Each <item> is either a\n"
+			"                  register address or the 'gpio' keyword for all GPIO inputs.\n"
+			"                  Sampling <rate> is 1000 Hz by default, the ring buffer keeps\n"
+			"                  the last <num> changes (4096 by default). Sampling continues\n"
+			"                  for <sec> seconds or until interrupted, then recorded changes\n"
+			"                  are dumped. SIGUSR1 dumps recorded changes without stopping.\n"
+			"  scan <file> [<threads>] Look for calibration data of any supported type at\n"
+			"                  any offset of the (flash) image <file> and report offset,\n"
+			"                  data type and validity of each found candidate. Image is\n"
+			"                  scanned with <threads> threads (one per CPU by default).\n"
+			"  agent [<socket>] Serve requests of the agent connector (-N option) of a\n"
+			"                  remote host via stdin/stdout or via the Unix socket <socket>.\n"
+			"  serve <socket>  Run as a daemon, which keeps the card connection and the\n"
+			"                  loaded data and serves requests on the Unix socket <socket>.\n"
+			"                  Each request is a text line with an action (e.g. 'dump base'\n"
+			"                  or 'regread 4020') and its response is terminated by the\n"
+			"                  'END <code>' line. Data are loaded on the first request and\n"
+			"                  then reused. Extra requests are: 'reload' to load data\n"
+			"                  again, 'invalidate' to forget loaded data, 'get <param>' to\n"
+			"                  print one of: eepmap, connector, mac, loaded, loads, eeplen,\n"
+			"                  eepreads, 'trace' to dump the recent data loading trace,\n"
+			"                  'quit' to close connection and 'shutdown' to stop\n"
+			"                  the daemon.\n"
+			"  script [<action> [<actarg>] [; <action> ...]] Run a sequence of actions\n"
+			"                  within a single session, so data are loaded only once. Actions\n"
+			"                  are taken from arguments, where they are separated with a\n"
+			"                  standalone ';', or from stdin one per line. Requests of the\n"
+			"                  'serve' action are supported as well. After an update only\n"
+			"                  written EEPROM words are read again. Script is stopped on\n"
+			"                  a first failed action.\n"
 			"\n"
 		);
 	} else {
@@ -903,6 +1360,10 @@ static void usage(struct atheepmgr *aem, char *name)
 			"  gpiodump        Dump GPIO lines state to the terminal.\n"
 			"  regread <addr>  Read register at address <addr> and print it value.\n"
 			"  regwrite <addr> <val> Write value <val> to the register at address <addr>.\n"
+			"  regdump <start> <end> <file> Save registers snapshot to the file <file>.\n"
+			"  watch <item> [<item> ...] Record registers and/or GPIO inputs changes.\n"
+			"  serve <socket>  Serve requests on the Unix socket <socket>.\n"
+			"  script [<action> [<actarg>] [; <action> ...]] Run actions in one session.\n"
 			"\n"
 		);
 	}
@@ -914,9 +1375,13 @@ static void usage(struct atheepmgr *aem, char *name)
 		"                  by -D option. Since each driver have a specific debug\n"
 		"                  interface, utility first determine serving driver and then\n"
 		"                  automatically configured themself to work with this driver.\n"
+		"                  For ath10k the whole calibration data are fetched at once\n"
+		"                  from the driver 'cal_data' debugfs file if it is available.\n"
 #endif
 		"  File            Read EEPROM dump from file, activated by -F option with dump\n"
 		"                  file path argument.\n"
+		"  Stream          Read EEPROM dump from a descriptor (e.g. pipe) at once and\n"
+		"                  process it in memory, activated by -I option.\n"
 #if defined(CONFIG_CON_MEM)
 		"  Mem             Interact with card via /dev/mem by mapping device I/O memory\n"
 		"                  to the proccess memory, activated by -M option with the device\n"
@@ -938,15 +1403,342 @@ static void usage(struct atheepmgr *aem, char *name)
 	printf("\n");
 }
 
+/* Data loading attempt with tracing of its duration and result */
+#define LOAD_TRY(__src, __load)					\
+	({							\
+		bool __res;					\
+								\
+		TRACE(LOAD_START, __src);			\
+		PROBE(load_start, trace_src_names[__src]);	\
+		__res = __load;					\
+		PROBE(load_done, trace_src_names[__src], __res);\
+		TRACE(LOAD_DONE, __src, __res);			\
+		__res;						\
+	})
+
+static int action_raw_check(struct atheepmgr *aem, const struct action *act)
+{
+	if (!(act->flags & ACT_F_RAW_DATA))
+		return 0;
+
+	if ((act->flags & ACT_F_RAW_DATA) == ACT_F_RAW_EEP &&
+	    !(aem->eepmap->features & EEPMAP_F_RAW_EEP))
+		fprintf(stderr, "EEPROM map does not support RAW EEPROM contents loading\n");
+	else if ((act->flags & ACT_F_RAW_DATA) == ACT_F_RAW_OTP &&
+		   !(aem->eepmap->features & EEPMAP_F_RAW_OTP))
+		fprintf(stderr, "EEPROM map does not support RAW OTP contents loading\n");
+	else if (!(aem->eepmap->features & EEPMAP_F_RAW_DATA))
+		fprintf(stderr, "EEPROM map does not support any RAW data loading\n");
+	else
+		return 0;
+
+	return -EINVAL;
+}
+
+static int data_alloc(struct atheepmgr *aem)
+{
+	hw_eeprom_set_ops(aem);
+	hw_otp_set_ops(aem);
+
+	aem->eepmap_priv = malloc(aem->eepmap->priv_data_sz);
+	if (!aem->eepmap_priv) {
+		fprintf(stderr, "Unable to allocate memory for the EEPROM parser private data\n");
+		return -ENOMEM;
+	}
+
+	aem->eep_buf = malloc(aem->eepmap->eep_buf_sz * sizeof(uint16_t));
+	if (!aem->eep_buf) {
+		fprintf(stderr, "Unable to allocate memory for EEPROM buffer\n");
+		return -ENOMEM;
+	}
+	if (aem->eepmap->unpacked_buf_sz) {
+		aem->unpacked_buf = malloc(aem->eepmap->unpacked_buf_sz);
+		if (!aem->unpacked_buf) {
+			fprintf(stderr, "Unable to allocate memory for buffer of unpacked data\n");
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+/* Try to load data from the non-RAW source if it is available */
+static bool data_load_src(struct atheepmgr *aem, int src, int *tries)
+{
+	switch (src) {
+	case TRACE_SRC_BLOB:
+		if (!aem->con->blob || !aem->eepmap->load_blob)
+			return false;
+		(*tries)++;
+		return LOAD_TRY(TRACE_SRC_BLOB, aem->eepmap->load_blob(aem));
+	case TRACE_SRC_EEPROM:
+		if (!aem->eep || !aem->eepmap->load_eeprom)
+			return false;
+		(*tries)++;
+		return LOAD_TRY(TRACE_SRC_EEPROM,
+				aem->eepmap->load_eeprom(aem, false));
+	case TRACE_SRC_OTP:
+		if (!aem->otp || !aem->eepmap->load_otp)
+			return false;
+		(*tries)++;
+		return LOAD_TRY(TRACE_SRC_OTP, aem->eepmap->load_otp(aem, false));
+	}
+
+	return false;
+}
+
+static int __data_load(struct atheepmgr *aem, int flags)
+{
+	int tries = 0, cached, src = -1;
+
+	aem->data_base = -1;
+	aem->data_base_hint = -1;
+
+	if (flags & ACT_F_RAW_EEP &&
+	    aem->eepmap->features & EEPMAP_F_RAW_EEP &&
+	    aem->eep && aem->eepmap->load_eeprom) {
+		tries++;
+		if (LOAD_TRY(TRACE_SRC_RAW_EEPROM, aem->eepmap->load_eeprom(aem, true)))
+			goto loading_done;
+	}
+	if (flags & ACT_F_RAW_OTP &&
+	    aem->eepmap->features & EEPMAP_F_RAW_OTP &&
+	    aem->otp && aem->eepmap->load_otp) {
+		tries++;
+		if (LOAD_TRY(TRACE_SRC_RAW_OTP, aem->eepmap->load_otp(aem, true)))
+			goto loading_done;
+	}
+	if (flags & ACT_F_RAW_DATA)
+		goto no_data;
+
+	/* Try the source, which succeeded last time, first */
+	src = cached = srccache_get(aem, &aem->data_base_hint);
+	if (cached >= 0 && data_load_src(aem, cached, &tries))
+		goto loading_done;
+
+	for (src = TRACE_SRC_BLOB; src <= TRACE_SRC_OTP; ++src) {
+		if (src == cached)
+			continue;
+		if (data_load_src(aem, src, &tries))
+			goto loading_done;
+	}
+
+no_data:
+	if (aem->hw_dead) {
+		return -ENODEV;		/* Reason has already been reported */
+	} else if (tries) {
+		fprintf(stderr, "Unable to load data from any sources\n");
+		return -EIO;
+	} else {
+		fprintf(stderr, "No suitable data source in available via configured connector\n");
+		return -EINVAL;
+	}
+
+loading_done:
+	if (!(flags & ACT_F_RAW_DATA) && !aem->eepmap->check_eeprom(aem)) {
+		fprintf(stderr, "EEPROM check failed\n");
+		return -EINVAL;
+	}
+
+	if (src >= 0)		/* Non-RAW source */
+		srccache_put(aem, src, aem->data_base < 0 ? 0 : aem->data_base);
+
+	return 0;
+}
+
+/* Load data, loading trace is dumped on failure or in verbose mode */
+static int data_load(struct atheepmgr *aem, int flags)
+{
+	int ret;
+
+	trace_mark();
+	ret = __data_load(aem, flags);
+	if (ret)
+		trace_dump(stderr, false);
+	else if (aem->verbose)
+		trace_dump(stdout, false);
+
+	return ret;
+}
+
+/**
+ * Session (daemon or script mode) state: whether the buffers contain a checked
+ * data, which could be reused by subsequent requests without touching the
+ * EEPROM again. After an update the data are loaded again, but only written
+ * words are actually read from the device, all others are served from the
+ * EEPROM shadow.
+ */
+static bool session_data_valid;
+static unsigned int session_data_loads;
+
+static int session_data_load(struct atheepmgr *aem)
+{
+	int ret;
+
+	session_data_valid = false;
+	ret = data_load(aem, 0);
+	if (ret)
+		return ret;
+	session_data_valid = true;
+	session_data_loads++;
+
+	return 0;
+}
+
+static int session_get(struct atheepmgr *aem, int argc, char *argv[])
+{
+	if (argc < 1) {
+		fprintf(stderr, "Parameter name is not specified\n");
+		return -EINVAL;
+	}
+
+	if (strcmp(argv[0], "eepmap") == 0) {
+		printf("%s\n", aem->eepmap->name);
+	} else if (strcmp(argv[0], "connector") == 0) {
+		printf("%s\n", aem->con->name);
+	} else if (strcmp(argv[0], "mac") == 0) {
+		if (!(aem->con->caps & CON_CAP_HW)) {
+			fprintf(stderr, "MAC revision is not available without HW access\n");
+			return -EOPNOTSUPP;
+		}
+		printf("0x%04x rev 0x%02x\n", aem->macVersion, aem->macRev);
+	} else if (strcmp(argv[0], "loaded") == 0) {
+		printf("%s\n", session_data_valid ? "yes" : "no");
+	} else if (strcmp(argv[0], "loads") == 0) {
+		printf("%u\n", session_data_loads);
+	} else if (strcmp(argv[0], "eeplen") == 0) {
+		printf("%zu\n", session_data_valid ? aem->eep_len : 0);
+	} else if (strcmp(argv[0], "eepreads") == 0) {
+		printf("%lu\n", hw_eeprom_shadow_dev_reads(aem));
+	} else {
+		fprintf(stderr, "Unknown parameter -- %s\n", argv[0]);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int session_request(struct atheepmgr *aem, int argc, char *argv[])
+{
+	const struct action *act = NULL;
+	int i, ret;
+
+	hw_op_start(aem);	/* Deadline and errors budget are per request */
+
+	if (strcmp(argv[0], "invalidate") == 0) {
+		hw_eeprom_shadow_flush(aem);
+		session_data_valid = false;
+		return 0;
+	} else if (strcmp(argv[0], "reload") == 0) {
+		hw_eeprom_shadow_flush(aem);
+		return session_data_load(aem);
+	} else if (strcmp(argv[0], "get") == 0) {
+		return session_get(aem, argc - 1, argv + 1);
+	} else if (strcmp(argv[0], "trace") == 0) {
+		trace_dump(stdout, true);
+		return 0;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(actions); ++i) {
+		if (strcasecmp(argv[0], actions[i].name) != 0)
+			continue;
+		act = &actions[i];
+		break;
+	}
+	if (!act || act->flags & ACT_F_SESSION) {
+		fprintf(stderr, "Unknown request -- %s\n", argv[0]);
+		return -EINVAL;
+	}
+
+	if ((act->flags & ACT_F_HW) && !(aem->con->caps & CON_CAP_HW)) {
+		fprintf(stderr, "%s action require direct HW access, which is not proved by %s connector\n",
+			act->name, aem->con->name);
+		return -EINVAL;
+	}
+
+	/**
+	 * RAW data actions reuse the same buffers, so always load data for
+	 * them and consider the parsed data lost afterwards.
+	 */
+	if (act->flags & ACT_F_RAW_DATA) {
+		ret = action_raw_check(aem, act);
+		if (ret)
+			return ret;
+		session_data_valid = false;
+		ret = data_load(aem, act->flags);
+		if (ret)
+			return ret;
+	} else if (act->flags & ACT_F_DATA && !session_data_valid) {
+		ret = session_data_load(aem);
+		if (ret)
+			return ret;
+	}
+
+	ret = act->func(aem, argc - 1, argv + 1);
+
+	if (act->flags & ACT_F_MODIFY)
+		session_data_valid = false;
+
+	return ret;
+}
+
+static int act_serve(struct atheepmgr *aem, int argc, char *argv[])
+{
+	if (argc < 1) {
+		fprintf(stderr, "Socket path is not specified\n");
+		return -EINVAL;
+	}
+
+	return server_run(aem, argv[0], session_request);
+}
+
+static int act_script(struct atheepmgr *aem, int argc, char *argv[])
+{
+	char *line = NULL, *largv[SESSION_ARGS_MAX];
+	size_t linesz = 0;
+	int i, start, ret = 0;
+
+	/* Actions from arguments are separated by a standalone ';' */
+	if (argc) {
+		for (start = 0, i = 0; i <= argc && !ret; ++i) {
+			if (i < argc && strcmp(argv[i], ";") != 0)
+				continue;
+			if (i > start)
+				ret = session_request(aem, i - start,
+						      argv + start);
+			start = i + 1;
+		}
+		return ret;
+	}
+
+	/* Or read them from stdin one per line */
+	while (!ret && getline(&line, &linesz, stdin) != -1) {
+		i = str_split(line, largv, ARRAY_SIZE(largv));
+		if (i < 0) {
+			fprintf(stderr, "Too many request arguments, max is %d\n",
+				SESSION_ARGS_MAX - 1);
+			ret = i;
+		} else if (i && largv[0][0] != '#') {
+			ret = session_request(aem, i, largv);
+		}
+	}
+	free(line);
+
+	return ret;
+}
+
 int main(int argc, char *argv[])
 {
 	struct atheepmgr *aem = &__aem;
 	const struct action *act = NULL;
 	const struct eepmap *user_eepmap = NULL;
 	char *con_arg = NULL;
+	char *tplpack_arg = NULL;
+	char *srccache_arg = NULL;
+	char *endp;
 	int print_usage = 0;
 	int i, opt;
-	int ret;
+	int ret, res;
 
 	if (argc == 1)
 		print_usage = 1;
@@ -954,6 +1746,7 @@ int main(int argc, char *argv[])
 	aem->host_is_be = __BYTE_ORDER == __BIG_ENDIAN;
 	aem->eep_wp_gpio_num = EEP_WP_GPIO_AUTO;	/* Autodetection */
 	aem->eep_wp_gpio_pol = 0;		/* Unlock by low level */
+	aem->hw_err_budget = AH_ERR_BUDGET;
 
 	ret = -EINVAL;
 	while ((opt = getopt(argc, argv, optstr)) != -1) {
@@ -962,6 +1755,22 @@ int main(int argc, char *argv[])
 			aem->con = &con_file;
 			con_arg = optarg;
 			break;
+		case 'I':
+			aem->con = &con_stream;
+			con_arg = optarg;
+			break;
+		case 'R':
+			aem->con = &con_mtd;
+			con_arg = optarg;
+			break;
+		case 'B':
+			aem->con = &con_board;
+			con_arg = optarg;
+			break;
+		case 'N':
+			aem->con = &con_agent;
+			con_arg = optarg;
+			break;
 #if defined(CONFIG_CON_MEM)
 		case 'M':
 			aem->con = &con_mem;
@@ -990,6 +1799,28 @@ int main(int argc, char *argv[])
 				goto exit;
 			}
 			break;
+		case 'T':
+			tplpack_arg = optarg;
+			break;
+		case 'C':
+			srccache_arg = optarg;
+			break;
+		case 'E':
+			aem->hw_err_budget = strtoul(optarg, &endp, 0);
+			if (*endp != '\0' || endp == optarg) {
+				fprintf(stderr, "Invalid I/O errors number -- %s\n",
+					optarg);
+				goto exit;
+			}
+			break;
+		case 'L':
+			aem->hw_timeout = strtoul(optarg, &endp, 0);
+			if (*endp != '\0' || endp == optarg) {
+				fprintf(stderr, "Invalid operation deadline -- %s\n",
+					optarg);
+				goto exit;
+			}
+			break;
 		case 'v':
 			aem->verbose++;
 			break;
@@ -1001,6 +1832,15 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	hw_op_start(aem);
+
+	if (tplpack_arg) {
+		ret = tplpack_open(aem, tplpack_arg);
+		if (ret)
+			goto exit;
+		ret = -EINVAL;
+	}
+
 	if (print_usage) {
 		usage(aem, argv[0]);
 		ret = 0;
@@ -1023,6 +1863,11 @@ int main(int argc, char *argv[])
 		optind++;
 	}
 
+	if (act->flags & ACT_F_STANDALONE) {
+		ret = act->func(aem, argc - optind, argv + optind);
+		goto exit;
+	}
+
 	if (!aem->con) {
 		if (act->flags & ACT_F_AUTONOMOUS) {
 			aem->con = &con_stub;	/* to avoid conn. init crash */
@@ -1038,6 +1883,14 @@ int main(int argc, char *argv[])
 		goto exit;
 	}
 
+#if defined(CONFIG_CON_MMIO_INLINE)
+	if ((aem->con->caps & CON_CAP_HW) && !(aem->con->caps & CON_CAP_MMIO)) {
+		fprintf(stderr, "%s connector is not supported by this build, registers access is bound to the memory mapped I/O (Mem and PCI connectors)\n",
+			aem->con->name);
+		goto exit;
+	}
+#endif
+
 	if (!user_eepmap && !(aem->con->caps & CON_CAP_PNP)) {
 		fprintf(stderr, "EEPROM map type option is mandatory for connectors without chip autodetection (Plug and Play) support\n");
 		goto exit;
@@ -1073,21 +1926,9 @@ int main(int argc, char *argv[])
 		aem->eepmap = user_eepmap;
 	}
 
-	if (act->flags & ACT_F_RAW_DATA) {
-		ret = -EINVAL;
-		if ((act->flags & ACT_F_RAW_DATA) == ACT_F_RAW_EEP &&
-		    !(aem->eepmap->features & EEPMAP_F_RAW_EEP))
-			fprintf(stderr, "EEPROM map does not support RAW EEPROM contents loading\n");
-		else if ((act->flags & ACT_F_RAW_DATA) == ACT_F_RAW_OTP &&
-			   !(aem->eepmap->features & EEPMAP_F_RAW_OTP))
-			fprintf(stderr, "EEPROM map does not support RAW OTP contents loading\n");
-		else if (!(aem->eepmap->features & EEPMAP_F_RAW_DATA))
-			fprintf(stderr, "EEPROM map does not support any RAW data loading\n");
-		else
-			ret = 0;
-		if (ret)
-			goto con_clean;
-	}
+	ret = action_raw_check(aem, act);
+	if (ret)
+		goto con_clean;
 
 	if (aem->con->caps & CON_CAP_HW) {
 		ret = hw_init(aem);
@@ -1100,106 +1941,47 @@ int main(int argc, char *argv[])
 				aem->eep_wp_gpio_num, aem->gpio_num - 1);
 			goto con_clean;
 		}
-	}
-
-	if (act->flags & ACT_F_DATA) {
-		int tries = 0;
 
-		hw_eeprom_set_ops(aem);
-		hw_otp_set_ops(aem);
-
-		aem->eepmap_priv = malloc(aem->eepmap->priv_data_sz);
-		if (!aem->eepmap_priv) {
-			fprintf(stderr, "Unable to allocate memory for the EEPROM parser private data\n");
-			ret = -ENOMEM;
-			goto con_clean;
-		}
-
-		aem->eep_buf = malloc(aem->eepmap->eep_buf_sz *
-				      sizeof(uint16_t));
-		if (!aem->eep_buf) {
-			fprintf(stderr, "Unable to allocate memory for EEPROM buffer\n");
-			ret = -ENOMEM;
-			goto con_clean;
-		}
-		if (aem->eepmap->unpacked_buf_sz) {
-			aem->unpacked_buf =
-					malloc(aem->eepmap->unpacked_buf_sz);
-			if (!aem->unpacked_buf) {
-				fprintf(stderr, "Unable to allocate memory for buffer of unpacked data\n");
-				ret = -ENOMEM;
+		if (srccache_arg) {
+			ret = srccache_open(aem, srccache_arg, con_arg);
+			if (ret)
 				goto con_clean;
-			}
-		}
-
-		if (act->flags & ACT_F_RAW_EEP &&
-		    aem->eepmap->features & EEPMAP_F_RAW_EEP &&
-		    aem->eep && aem->eepmap->load_eeprom) {
-			tries++;
-			if (aem->verbose > 1)
-				printf("Try to load RAW EEPROM data\n");
-			if (aem->eepmap->load_eeprom(aem, true))
-				goto loading_done;
-		}
-		if (act->flags & ACT_F_RAW_OTP &&
-		    aem->eepmap->features & EEPMAP_F_RAW_OTP &&
-		    aem->otp && aem->eepmap->load_otp) {
-			tries++;
-			if (aem->verbose > 1)
-				printf("Try to load RAW OTP data\n");
-			if (aem->eepmap->load_otp(aem, true))
-				goto loading_done;
-		}
-		if (act->flags & ACT_F_RAW_DATA)
-			goto no_data;
-
-		if (aem->con->blob && aem->eepmap->load_blob) {
-			tries++;
-			if (aem->verbose > 1)
-				printf("Try to load data from blob\n");
-			if (aem->eepmap->load_blob(aem))
-				goto loading_done;
 		}
-		if (aem->eep && aem->eepmap->load_eeprom) {
-			tries++;
-			if (aem->verbose > 1)
-				printf("Try to load data from EEPROM\n");
-			if (aem->eepmap->load_eeprom(aem, false))
-				goto loading_done;
-		}
-		if (aem->otp && aem->eepmap->load_otp) {
-			tries++;
-			if (aem->verbose > 1)
-				printf("Try to load data from OTP memory\n");
-			if (aem->eepmap->load_otp(aem, false))
-				goto loading_done;
-		}
-
-no_data:
-		if (tries) {
-			fprintf(stderr, "Unable to load data from any sources\n");
-			ret = -EIO;
-		} else {
-			fprintf(stderr, "No suitable data source in available via configured connector\n");
-			ret = -EINVAL;
-		}
-		goto con_clean;
+	}
 
-loading_done:
-		if (!(act->flags & ACT_F_RAW_DATA) &&
-		    !aem->eepmap->check_eeprom(aem)) {
-			fprintf(stderr, "EEPROM check failed\n");
-			ret = -EINVAL;
+	if (act->flags & (ACT_F_DATA | ACT_F_SESSION)) {
+		ret = data_alloc(aem);
+		if (ret)
+			goto con_clean;
+		ret = hw_eeprom_shadow_init(aem);
+		if (ret)
 			goto con_clean;
-		}
 	}
 
-	ret = act->func(aem, argc - optind, argv + optind);
+	/* Connector could provide several data entries, process each of them */
+	do {
+		hw_eeprom_shadow_flush(aem);	/* Entry could be changed */
+		if (act->flags & ACT_F_DATA)
+			res = data_load(aem, act->flags);
+		else
+			res = 0;
+		if (!res)
+			res = act->func(aem, argc - optind, argv + optind);
+		if (res)
+			ret = res;
+	} while (act->flags & ACT_F_DATA && aem->con->next &&
+		 aem->con->next(aem) == 0);
+
+	if (!ret && aem->con->flush)
+		ret = aem->con->flush(aem);
 
 con_clean:
 	aem->con->clean(aem);
 
 exit:
+	hw_eeprom_shadow_clean(aem);
+	srccache_close(aem);
+	tplpack_close(aem);
 	free(aem->unpacked_buf);
 	free(aem->eep_buf);
 	free(aem->eepmap_priv);
@@ -25,6 +25,8 @@
 #include <errno.h>
 #include <stdint.h>
 
+#include "probe.h"
+
 #if defined(__OpenBSD__)
 #include <sys/param.h>
 /* OpenBSD only starting from version 5.6 contains le16toh() and le32toh() */
@@ -77,6 +79,8 @@ enum {
 
 typedef int bool;
 
+#include "trace.h"
+
 #define AR_SREV_VERSION_5211		0x4
 #define AR_SREV_REVISION_5211		0
 #define AR_SREV_VERSION_5212		0x5
@@ -141,22 +145,39 @@ typedef int bool;
 
 #define AH_WAIT_TIMEOUT		100000 /* (us) */
 #define AH_TIME_QUANTUM		10
+#define AH_ERR_BUDGET		16	/* I/O errors before giving up */
 
 #define CON_CAP_HW		1	/* Con. is able to interact with HW */
 #define CON_CAP_PNP		2	/* Con. is able to detect EEP layout */
+#define CON_CAP_MMIO		4	/* Con. maps registers to aem->io_map */
 
 #define EEP_WP_GPIO_AUTO	-1	/* Use autodetection */
 #define EEP_WP_GPIO_NONE	-2	/* Do not use GPIO for unlocking */
 
 struct atheepmgr;
+struct tplpack;
+struct srccache;
+struct eep_shadow;
+
+#define GPIO_NUM_MAX		32
+
+/* State of all GPIO lines, decoded from a single read of each register */
+struct gpio_snapshot {
+	uint32_t input;				/* Input values bitmap */
+	uint32_t output;			/* Output values bitmap */
+	const char *dir_str[GPIO_NUM_MAX];
+	const char *out_mux_str[GPIO_NUM_MAX];	/* NULL if unsupported */
+};
 
 struct gpio_ops {
 	int (*input_get)(struct atheepmgr *aem, unsigned gpio);
+	uint32_t (*inputs_get)(struct atheepmgr *aem);	/* All lines at once */
 	int (*output_get)(struct atheepmgr *aem, unsigned gpio);
 	void (*output_set)(struct atheepmgr *aem, unsigned gpio, int val);
 	void (*dir_set_out)(struct atheepmgr *aem, unsigned gpio);
 	const char * (*dir_get_str)(struct atheepmgr *aem, unsigned gpio);
 	const char * (*out_mux_get_str)(struct atheepmgr *aem, unsigned gpio);
+	void (*snapshot)(struct atheepmgr *aem, struct gpio_snapshot *snap);
 };
 
 struct blob_ops {
@@ -185,6 +206,12 @@ struct connector {
 	void (*reg_write)(struct atheepmgr *aem, uint32_t reg, uint32_t val);
 	void (*reg_rmw)(struct atheepmgr *aem, uint32_t reg, uint32_t set,
 			uint32_t clr);
+	int (*reg_bulk_read)(struct atheepmgr *aem, uint32_t reg,
+			     uint32_t *vals, unsigned int num);	/* Optional */
+	bool (*wait)(struct atheepmgr *aem, uint32_t reg, uint32_t mask,
+		     uint32_t val, uint32_t timeout);	/* Optional */
+	int (*next)(struct atheepmgr *aem);	/* Optional, select next data */
+	int (*flush)(struct atheepmgr *aem);	/* Optional, on action success */
 	const struct blob_ops *blob;
 	const struct eep_ops *eep;
 	const struct otp_ops *otp;
@@ -255,6 +282,7 @@ struct atheepmgr {
 
 	const struct connector *con;
 	void *con_priv;
+	void *io_map;				/* Registers of MMIO con. */
 
 	uint32_t macVersion;
 	uint16_t macRev;
@@ -273,18 +301,34 @@ struct atheepmgr {
 	int eep_wp_gpio_pol;			/* EEPROM WP unlock polarity */
 
 	const struct eep_ops *eep;
+	struct eep_shadow *eep_shadow;		/* EEPROM words read-through cache */
 
 	const struct otp_ops *otp;
 	int otp_was_enabled;
 
 	const struct gpio_ops *gpio;
 	unsigned gpio_num;			/* Number of GPIO lines */
+
+	struct tplpack *tplpack;		/* External templates pack */
+	struct srccache *srccache;		/* Data source cache */
+	int data_base;				/* Base address of loaded data */
+	int data_base_hint;			/* Base address to try first */
+
+	unsigned int hw_err_budget;		/* I/O errors before giving up */
+	unsigned int hw_errs;			/* Number of I/O errors */
+	unsigned int hw_timeout;		/* Operation timeout, ms */
+	uint64_t hw_deadline;			/* Operation deadline, ms */
+	bool hw_dead;				/* Device is not responding */
 };
 
+extern const struct connector con_agent;
+extern const struct connector con_board;
 extern const struct connector con_file;
 extern const struct connector con_driver;
 extern const struct connector con_mem;
+extern const struct connector con_mtd;
 extern const struct connector con_pci;
+extern const struct connector con_stream;
 extern const struct connector con_stub;
 
 extern const struct eepmap eepmap_5211;
@@ -298,17 +342,58 @@ extern const struct eepmap eepmap_9888;
 
 int chips_find_by_pci_id(uint16_t dev_id, const struct chip *res[], int nmemb);
 
+void hw_io_error(struct atheepmgr *aem);
+void hw_reg_check_ones(struct atheepmgr *aem, uint32_t reg);
+void hw_op_start(struct atheepmgr *aem);
+bool hw_is_alive(struct atheepmgr *aem);
 bool hw_wait(struct atheepmgr *aem, uint32_t reg, uint32_t mask,
 	     uint32_t val, uint32_t timeout);
+void hw_reg_bulk_read(struct atheepmgr *aem, uint32_t reg, uint32_t *vals,
+		      unsigned int num);
 void hw_eeprom_set_ops(struct atheepmgr *aem);
 bool hw_eeprom_read(struct atheepmgr *aem, uint32_t off, uint16_t *data);
 bool hw_eeprom_write(struct atheepmgr *aem, uint32_t off, uint16_t data);
+int hw_eeprom_probe_size(struct atheepmgr *aem, int max_len);
 void hw_eeprom_lock(struct atheepmgr *aem, int lock);
+int hw_eeprom_shadow_init(struct atheepmgr *aem);
+void hw_eeprom_shadow_flush(struct atheepmgr *aem);
+void hw_eeprom_shadow_invalidate(struct atheepmgr *aem);
+unsigned long hw_eeprom_shadow_dev_reads(struct atheepmgr *aem);
+void hw_eeprom_shadow_clean(struct atheepmgr *aem);
 void hw_otp_set_ops(struct atheepmgr *aem);
 bool hw_otp_enable(struct atheepmgr *aem, int enable);
 bool hw_otp_read(struct atheepmgr *aem, uint32_t off, uint8_t *data);
 int hw_init(struct atheepmgr *aem);
 
+int tplpack_open(struct atheepmgr *aem, const char *fname);
+void tplpack_close(struct atheepmgr *aem);
+const struct eeptemplate *tplpack_lookup(struct atheepmgr *aem,
+					 const struct eepmap *eepmap,
+					 int id, const char *name);
+const struct eeptemplate *tplpack_nth(struct atheepmgr *aem,
+				      const struct eepmap *eepmap, int n);
+void tplpack_list(struct atheepmgr *aem, const struct eepmap *eepmap);
+
+int srccache_open(struct atheepmgr *aem, const char *path,
+		  const char *con_arg);
+int srccache_get(struct atheepmgr *aem, int *base);
+void srccache_put(struct atheepmgr *aem, int src, int base);
+void srccache_close(struct atheepmgr *aem);
+
+#define SESSION_ARGS_MAX	16	/* Max number of request arguments */
+
+typedef int (*server_req_handler_t)(struct atheepmgr *aem, int argc,
+				    char *argv[]);
+int server_listen(const char *path, int backlog);
+int server_run(struct atheepmgr *aem, const char *path,
+	       server_req_handler_t handler);
+
+int watch_run(struct atheepmgr *aem, int argc, char *argv[]);
+
+int scan_run(struct atheepmgr *aem, int argc, char *argv[]);
+
+int agent_run(struct atheepmgr *aem, int argc, char *argv[]);
+
 #define EEP_READ(_off, _data)		\
 		hw_eeprom_read(aem, _off, _data)
 #define EEP_WRITE(_off, _data)		\
@@ -324,10 +409,94 @@ int hw_init(struct atheepmgr *aem);
 #define OTP_READ(_off, _data)		\
 		hw_otp_read(aem, _off, _data)
 #define REG_READ(_reg)			\
-		aem->con->reg_read(aem, _reg)
+		hw_reg_read(aem, _reg)
 #define REG_WRITE(_reg, _val)		\
-		aem->con->reg_write(aem, _reg, _val)
+		hw_reg_write(aem, _reg, _val)
 #define REG_RMW(_reg, _set, _clr)	\
-		aem->con->reg_rmw(aem, _reg, _set, _clr)
+		hw_reg_rmw(aem, _reg, _set, _clr)
+
+#if defined(CONFIG_CON_MMIO_INLINE)
+/**
+ * Registers access is bound at build time to the memory mapping of the MMIO
+ * connector (Mem or PCI), so accessors are inlined into the EEPROM, OTP and
+ * GPIO code without an indirect call per register access.
+ */
+static inline uint32_t __hw_reg_read(struct atheepmgr *aem, uint32_t reg)
+{
+	return *((volatile uint32_t *)(aem->io_map + reg));
+}
+
+static inline void __hw_reg_write(struct atheepmgr *aem, uint32_t reg,
+				  uint32_t val)
+{
+	*((volatile uint32_t *)(aem->io_map + reg)) = val;
+}
+
+static inline void __hw_reg_rmw(struct atheepmgr *aem, uint32_t reg,
+				uint32_t set, uint32_t clr)
+{
+	uint32_t tmp;
+
+	tmp = *((volatile uint32_t *)(aem->io_map + reg));
+	tmp &= ~clr;
+	tmp |= set;
+	*((volatile uint32_t *)(aem->io_map + reg)) = tmp;
+}
+#else
+/* Connector registers access dispatch */
+static inline uint32_t __hw_reg_read(struct atheepmgr *aem, uint32_t reg)
+{
+	return aem->con->reg_read(aem, reg);
+}
+
+static inline void __hw_reg_write(struct atheepmgr *aem, uint32_t reg,
+				  uint32_t val)
+{
+	aem->con->reg_write(aem, reg, val);
+}
+
+static inline void __hw_reg_rmw(struct atheepmgr *aem, uint32_t reg,
+				uint32_t set, uint32_t clr)
+{
+	aem->con->reg_rmw(aem, reg, set, clr);
+}
+#endif
+
+/* Registers of a dead device are not touched, reads return all-ones */
+static inline uint32_t hw_reg_read(struct atheepmgr *aem, uint32_t reg)
+{
+	uint32_t val;
+
+	if (aem->hw_dead)
+		return ~0;
+
+	val = __hw_reg_read(aem, reg);
+	if (val == ~0U)		/* Typical result of a vanished device */
+		hw_reg_check_ones(aem, reg);
+
+	PROBE(reg_read, reg, val);
+
+	return val;
+}
+
+static inline void hw_reg_write(struct atheepmgr *aem, uint32_t reg,
+				uint32_t val)
+{
+	if (aem->hw_dead)
+		return;
+
+	PROBE(reg_write, reg, val);
+	__hw_reg_write(aem, reg, val);
+}
+
+static inline void hw_reg_rmw(struct atheepmgr *aem, uint32_t reg,
+			      uint32_t set, uint32_t clr)
+{
+	if (aem->hw_dead)
+		return;
+
+	PROBE(reg_rmw, reg, set, clr);
+	__hw_reg_rmw(aem, reg, set, clr);
+}
 
 #endif /* ATHEEPMGR_H */
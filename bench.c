@@ -0,0 +1,639 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "atheepmgr.h"
+#include "eep_common.h"
+#include "gen.h"
+
+/**
+ * Benchmark of the internal routines. It is not a part of the utility and is
+ * built by the 'make bench' target.
+ *
+ * Each EEPROM map is benchmarked with a corpus file <dir>/<eepmap>.bin if the
+ * corpus directory is specified. If there are no corpus file for a map, then
+ * a synthetic image is generated from the seed (see gen.c). OTP loading is
+ * benchmarked in the same way with a <dir>/<eepmap>-otp.bin file.
+ */
+
+static const struct eepmap * const bench_eepmaps[] = {
+	&eepmap_5211,
+	&eepmap_5416,
+	&eepmap_6174,
+	&eepmap_9285,
+	&eepmap_9287,
+	&eepmap_9300,
+	&eepmap_9880,
+	&eepmap_9888,
+};
+
+static const char * const bench_sect_names[EEP_SECT_MAX] = {
+	[EEP_SECT_INIT] = "init",
+	[EEP_SECT_BASE] = "base",
+	[EEP_SECT_MODAL] = "modal",
+	[EEP_SECT_POWER] = "power",
+};
+
+struct bench_res {
+	char subj[16];		/* Tested subject: EEPROM map, kernel, etc. */
+	char test[24];		/* Test name */
+	uint64_t iters;		/* Number of performed iterations */
+	uint64_t ns;		/* Total time of all iterations */
+	size_t bytes;		/* Bytes processed per iteration, 0 if N/A */
+};
+
+#define BENCH_RES_MAX		256
+
+static struct bench_res bench_res[BENCH_RES_MAX];
+static unsigned int bench_res_num;
+static uint64_t bench_min_ns = 200000000ULL;	/* Run each test at least */
+static uint64_t bench_seed = 1;			/* Synthetic data seed */
+static int bench_verbose;
+
+static const char * const bench_layout_sfx[] = {
+	[GEN_LAYOUT_EEPROM] = "",
+	[GEN_LAYOUT_OTP] = "-otp",
+};
+
+static uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Run the statement in batches of iterations until the minimal test time is
+ * elapsed, batches make the clock reading overhead negligible.
+ */
+#define BENCH_LOOP(__iters, __ns, __stmt)				\
+	do {								\
+		uint64_t __start = bench_now();				\
+		int __i;						\
+									\
+		(__iters) = 0;						\
+		do {							\
+			for (__i = 0; __i < 16; ++__i) {		\
+				__stmt;					\
+			}						\
+			(__iters) += __i;				\
+			(__ns) = bench_now() - __start;			\
+		} while ((__ns) < bench_min_ns);			\
+	} while (0)
+
+static void bench_report(const char *subj, const char *test, uint64_t iters,
+			 uint64_t ns, size_t bytes)
+{
+	struct bench_res *r;
+
+	if (bench_res_num == BENCH_RES_MAX) {
+		fprintf(stderr, "bench: too many results, %s/%s is dropped\n",
+			subj, test);
+		return;
+	}
+
+	r = &bench_res[bench_res_num++];
+	snprintf(r->subj, sizeof(r->subj), "%s", subj);
+	snprintf(r->test, sizeof(r->test), "%s", test);
+	r->iters = iters;
+	r->ns = ns;
+	r->bytes = bytes;
+}
+
+static double bench_res_ns_per_op(const struct bench_res *r)
+{
+	return (double)r->ns / r->iters;
+}
+
+static double bench_res_mibps(const struct bench_res *r)
+{
+	return (double)r->bytes * r->iters / r->ns * 1e9 / (1024 * 1024);
+}
+
+static void bench_print_table(void)
+{
+	const struct bench_res *r;
+	unsigned int i;
+
+	printf("%-10s %-20s %12s %12s\n", "subject", "test", "ns/op", "MiB/s");
+	for (i = 0; i < bench_res_num; ++i) {
+		r = &bench_res[i];
+		printf("%-10s %-20s %12.1f", r->subj, r->test,
+		       bench_res_ns_per_op(r));
+		if (r->bytes)
+			printf(" %12.1f\n", bench_res_mibps(r));
+		else
+			printf(" %12s\n", "-");
+	}
+}
+
+static void bench_print_json(void)
+{
+	const struct bench_res *r;
+	unsigned int i;
+
+	printf("{\n  \"results\": [\n");
+	for (i = 0; i < bench_res_num; ++i) {
+		r = &bench_res[i];
+		printf("    {\"subject\": \"%s\", \"test\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.1f",
+		       r->subj, r->test, (unsigned long long)r->iters,
+		       bench_res_ns_per_op(r));
+		if (r->bytes)
+			printf(", \"bytes\": %zu, \"mib_per_s\": %.1f",
+			       r->bytes, bench_res_mibps(r));
+		printf("}%s\n", i + 1 < bench_res_num ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+/* Avoid the loop elimination by the compiler */
+static volatile uint16_t bench_sink;
+
+static int bench_csum(void)
+{
+	/* Typical EEPROM data, AR93xx block and a bulk buffer sizes */
+	static const size_t sizes[] = {0x300, 0x440, 0x1000, 0x10000};
+	const struct csum_impl *impl, *ref = NULL;
+	uint64_t iters, ns;
+	char test[24];
+	uint8_t *buf;
+	int i, j, ret = 0;
+
+	buf = malloc(sizes[ARRAY_SIZE(sizes) - 1] + 2);
+	if (!buf) {
+		fprintf(stderr, "Unable to allocate memory for the test data\n");
+		return -ENOMEM;
+	}
+	srand(1);
+	for (i = 0; i < sizes[ARRAY_SIZE(sizes) - 1] + 2; ++i)
+		buf[i] = rand();
+
+	for (impl = csum_impls; impl->name; ++impl)
+		ref = impl;	/* Last one is a reference implementation */
+
+	if (bench_verbose)
+		fprintf(stderr, "bench: selected checksum kernel is %s\n",
+			csum_impl_select()->name);
+
+	for (impl = csum_impls; impl->name; ++impl) {
+		if (impl->supported && !impl->supported()) {
+			if (bench_verbose)
+				fprintf(stderr, "bench: %s kernel is unsupported by CPU\n",
+					impl->name);
+			continue;
+		}
+
+		/* Check results consistency, including unaligned tails */
+		for (i = 0; i < 257; ++i) {
+			for (j = 0; j < 2; ++j) {
+				if (impl->xor16((uint16_t *)buf + j, i) !=
+				    ref->xor16((uint16_t *)buf + j, i) ||
+				    impl->sum8(buf + j, i) !=
+				    ref->sum8(buf + j, i)) {
+					fprintf(stderr, "%s: result mismatch for %d bytes at offset %d\n",
+						impl->name, i, j);
+					ret = -EINVAL;
+				}
+			}
+		}
+
+		for (i = 0; i < ARRAY_SIZE(sizes); ++i) {
+			snprintf(test, sizeof(test), "csum-xor16-%zu",
+				 sizes[i]);
+			BENCH_LOOP(iters, ns, bench_sink =
+				   impl->xor16((uint16_t *)buf, sizes[i] / 2));
+			bench_report(impl->name, test, iters, ns, sizes[i]);
+		}
+		for (i = 0; i < ARRAY_SIZE(sizes); ++i) {
+			snprintf(test, sizeof(test), "csum-sum8-%zu", sizes[i]);
+			BENCH_LOOP(iters, ns, bench_sink =
+				   impl->sum8(buf, sizes[i]));
+			bench_report(impl->name, test, iters, ns, sizes[i]);
+		}
+	}
+
+	free(buf);
+
+	return ret;
+}
+
+/* Same data sources order as in the utility itself */
+static bool bench_load(struct atheepmgr *aem)
+{
+	const struct eepmap *eepmap = aem->eepmap;
+
+	if (aem->con->blob && eepmap->load_blob && eepmap->load_blob(aem))
+		return true;
+	if (aem->eep && eepmap->load_eeprom && eepmap->load_eeprom(aem, false))
+		return true;
+	if (aem->otp && eepmap->load_otp && eepmap->load_otp(aem, false))
+		return true;
+
+	return false;
+}
+
+static int bench_con_init(struct atheepmgr *aem, const char *fname)
+{
+	int ret;
+
+	ret = aem->con->init(aem, fname);
+	if (ret)
+		return ret;
+	hw_eeprom_set_ops(aem);
+	hw_otp_set_ops(aem);
+
+	return 0;
+}
+
+/* Whole cycle: connector initialization, data loading and cleanup */
+static bool bench_con_load(struct atheepmgr *aem, const char *fname)
+{
+	bool res;
+
+	if (bench_con_init(aem, fname))
+		return false;
+	aem->eep_io_swap = false;
+	res = bench_load(aem);
+	aem->con->clean(aem);
+
+	return res;
+}
+
+static const uint8_t *bench_tpl_lookup(struct atheepmgr *aem, int id)
+{
+	const struct eeptemplate *tpl;
+
+	for (tpl = aem->eepmap->templates; tpl->name; ++tpl)
+		if (tpl->id == id)
+			return tpl->data;
+
+	return NULL;
+}
+
+/**
+ * Benchmark AR93xx-style block decompression: the first template is used as
+ * a reference, and each 16-th octet is patched, what gives a worst case of
+ * the many short blocks.
+ */
+static void bench_eepmap_decomp(struct atheepmgr *aem)
+{
+	const struct eepmap *eepmap = aem->eepmap;
+	const struct eeptemplate *tpl = &eepmap->templates[0];
+	size_t data_len = eepmap->unpacked_buf_sz;
+	struct ar9300_comp_hdr hdr;
+	uint8_t comp[2048], *out = aem->unpacked_buf;
+	uint64_t iters, ns;
+	int currref, pos, spot, len = 0;
+	int verbose = aem->verbose;
+
+	for (spot = 0, pos = 8; pos < data_len && len + 3 <= sizeof(comp);
+	     pos += 16) {
+		comp[len++] = pos - spot;	/* Offset from the prev. block */
+		comp[len++] = 1;		/* Block length */
+		comp[len++] = ((const uint8_t *)tpl->data)[pos] ^ 0x5a;
+		spot = pos + 1;
+	}
+
+	memset(&hdr, 0x00, sizeof(hdr));
+	hdr.comp = AR9300_COMP_BLOCK;
+	hdr.ref = tpl->id;
+	hdr.len = len;
+
+	aem->verbose = 0;
+	BENCH_LOOP(iters, ns, {
+		currref = -1;	/* Force template reloading */
+		ar9300_compress_decision(aem, 0, &hdr, out, comp, data_len,
+					 &currref, bench_tpl_lookup);
+	});
+	aem->verbose = verbose;
+
+	bench_report(eepmap->name, "decompress", iters, ns, data_len);
+}
+
+static void bench_eepmap_dump(struct atheepmgr *aem)
+{
+	const struct eepmap *eepmap = aem->eepmap;
+	uint64_t iters, ns;
+	char test[24];
+	int i, nullfd, stdoutfd;
+
+	nullfd = open("/dev/null", O_WRONLY);
+	if (nullfd < 0) {
+		fprintf(stderr, "bench: unable to open /dev/null: %s\n",
+			strerror(errno));
+		return;
+	}
+
+	for (i = 0; i < EEP_SECT_MAX; ++i) {
+		if (!eepmap->dump[i])
+			continue;
+
+		/* Measure the formatting only, so drop the output */
+		fflush(stdout);
+		stdoutfd = dup(STDOUT_FILENO);
+		dup2(nullfd, STDOUT_FILENO);
+		BENCH_LOOP(iters, ns, eepmap->dump[i](aem));
+		fflush(stdout);
+		dup2(stdoutfd, STDOUT_FILENO);
+		close(stdoutfd);
+
+		snprintf(test, sizeof(test), "dump-%s", bench_sect_names[i]);
+		bench_report(eepmap->name, test, iters, ns, 0);
+	}
+
+	close(nullfd);
+}
+
+#define BENCH_TMP_PREFIX	"/tmp/atheepmgr-bench-"
+
+static bool bench_is_tmp(const char *fname)
+{
+	return strncmp(fname, BENCH_TMP_PREFIX, strlen(BENCH_TMP_PREFIX)) == 0;
+}
+
+static int bench_write(const char *fname, int fd, const uint8_t *buf,
+		       size_t len)
+{
+	if (fd < 0)
+		fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || write(fd, buf, len) != len) {
+		fprintf(stderr, "bench: unable to write %s: %s\n", fname,
+			strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -EIO;
+	}
+	close(fd);
+
+	return 0;
+}
+
+/**
+ * Find a corpus file of the map or generate a temporary one, returns zero on
+ * success, positive value if there are no data and a negative error code.
+ */
+static int bench_eepmap_file(const struct eepmap *eepmap, const char *corpus,
+			     enum gen_layout layout, char *fname, size_t size,
+			     struct stat *st)
+{
+	static uint8_t buf[GEN_IMAGE_MAX];
+	int len, ret;
+
+	if (corpus) {
+		snprintf(fname, size, "%s/%s%s.bin", corpus, eepmap->name,
+			 bench_layout_sfx[layout]);
+		if (stat(fname, st) == 0)
+			return 0;
+	}
+
+	len = gen_image(eepmap, layout, bench_seed, buf, sizeof(buf));
+	if (len <= 0) {
+		fname[0] = '\0';
+		return len < 0 ? len : 1;
+	}
+
+	snprintf(fname, size, BENCH_TMP_PREFIX "XXXXXX");
+	ret = bench_write(fname, mkstemp(fname), buf, len);
+	if (ret) {
+		unlink(fname);
+		fname[0] = '\0';
+		return ret;
+	}
+
+	return stat(fname, st);
+}
+
+/* OTP data loading, if the map supports OTP and there are some data */
+static void bench_eepmap_otp(struct atheepmgr *aem, const char *corpus)
+{
+	const struct eepmap *eepmap = aem->eepmap;
+	char fname[0x100];
+	uint64_t iters, ns;
+	struct stat st;
+
+	if (!eepmap->load_otp)
+		return;
+	if (bench_eepmap_file(eepmap, corpus, GEN_LAYOUT_OTP, fname,
+			      sizeof(fname), &st) != 0)
+		return;
+
+	if (bench_con_load(aem, fname)) {
+		BENCH_LOOP(iters, ns, bench_con_load(aem, fname));
+		bench_report(eepmap->name, "load-otp", iters, ns, st.st_size);
+	} else {
+		fprintf(stderr, "bench: unable to load %s OTP data from %s\n",
+			eepmap->name, fname);
+	}
+
+	if (bench_is_tmp(fname))
+		unlink(fname);
+}
+
+/* Write synthetic corpus: <dir>/<eepmap>[-otp][.<n>].bin */
+static int bench_gen_corpus(const char *dir, int num)
+{
+	static uint8_t buf[GEN_IMAGE_MAX];
+	char fname[0x100], idx[16];
+	int i, j, n, len, ret;
+
+	for (i = 0; i < ARRAY_SIZE(bench_eepmaps); ++i) {
+		for (j = 0; j < ARRAY_SIZE(bench_layout_sfx); ++j) {
+			for (n = 0; n < num; ++n) {
+				len = gen_image(bench_eepmaps[i], j,
+						bench_seed + n, buf,
+						sizeof(buf));
+				if (len < 0)
+					return len;
+				if (len == 0)
+					break;
+				if (n)
+					snprintf(idx, sizeof(idx), ".%d", n);
+				else
+					idx[0] = '\0';
+				snprintf(fname, sizeof(fname), "%s/%s%s%s.bin",
+					 dir, bench_eepmaps[i]->name,
+					 bench_layout_sfx[j], idx);
+				ret = bench_write(fname, -1, buf, len);
+				if (ret)
+					return ret;
+				if (bench_verbose)
+					printf("%s: %d octets\n", fname, len);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int bench_eepmap(const struct eepmap *eepmap, const char *corpus)
+{
+	struct atheepmgr __aem, *aem = &__aem;
+	char fname[0x100] = "";
+	uint64_t iters, ns;
+	struct stat st;
+	int ret = 0;
+
+	memset(aem, 0x00, sizeof(*aem));
+	aem->host_is_be = __BYTE_ORDER == __BIG_ENDIAN;
+	aem->eep_wp_gpio_num = EEP_WP_GPIO_NONE;
+	aem->con = &con_file;
+	aem->eepmap = eepmap;
+
+	aem->con_priv = malloc(aem->con->priv_data_sz);
+	aem->eepmap_priv = malloc(eepmap->priv_data_sz);
+	aem->eep_buf = malloc(eepmap->eep_buf_sz * sizeof(uint16_t));
+	if (eepmap->unpacked_buf_sz)
+		aem->unpacked_buf = malloc(eepmap->unpacked_buf_sz);
+	if (!aem->con_priv || !aem->eepmap_priv || !aem->eep_buf ||
+	    (eepmap->unpacked_buf_sz && !aem->unpacked_buf)) {
+		fprintf(stderr, "bench: unable to allocate memory for %s buffers\n",
+			eepmap->name);
+		ret = -ENOMEM;
+		goto exit;
+	}
+
+	if (eepmap->templates && eepmap->unpacked_buf_sz)
+		bench_eepmap_decomp(aem);
+
+	ret = bench_eepmap_file(eepmap, corpus, GEN_LAYOUT_EEPROM, fname,
+				sizeof(fname), &st);
+	if (ret) {
+		if (ret > 0 && bench_verbose)
+			fprintf(stderr, "bench: there are no data for %s, skipping\n",
+				eepmap->name);
+		ret = ret > 0 ? 0 : ret;
+		goto exit;
+	}
+
+	/* Keep data loaded for the further tests */
+	if (bench_con_init(aem, fname) != 0 || !bench_load(aem)) {
+		fprintf(stderr, "bench: unable to load %s data from %s\n",
+			eepmap->name, fname);
+		ret = -EINVAL;
+		goto exit;
+	}
+	aem->con->clean(aem);
+
+	BENCH_LOOP(iters, ns, bench_con_load(aem, fname));
+	bench_report(eepmap->name, "load-file", iters, ns, st.st_size);
+
+	/* Corpus data could be unchecksummed, so a failed check is tolerated */
+	if (eepmap->check_eeprom(aem)) {
+		BENCH_LOOP(iters, ns, eepmap->check_eeprom(aem));
+		bench_report(eepmap->name, "check", iters, ns, 0);
+	} else if (bench_verbose) {
+		fprintf(stderr, "bench: %s data check failed, skip check test\n",
+			eepmap->name);
+	}
+
+	bench_eepmap_dump(aem);
+
+	bench_eepmap_otp(aem, corpus);
+
+exit:
+	if (fname[0] && bench_is_tmp(fname))
+		unlink(fname);
+	free(aem->unpacked_buf);
+	free(aem->eep_buf);
+	free(aem->eepmap_priv);
+	free(aem->con_priv);
+
+	return ret;
+}
+
+static void usage(const char *name)
+{
+	printf(
+		"Usage:\n"
+		"  %s [-c <dir>] [-j] [-s <suite>] [-t <ms>] [-S <seed>] [-v]\n"
+		"  %s -g <dir> [-n <num>] [-S <seed>] [-v]\n"
+		"\n"
+		"Options:\n"
+		"  -c <dir>        Use corpus files <dir>/<eepmap>[-otp].bin\n"
+		"  -g <dir>        Generate synthetic corpus into <dir> and exit\n"
+		"  -j              Print results in JSON format instead of table\n"
+		"  -n <num>        Number of images per map to generate, each next\n"
+		"                  image is written as <eepmap>[-otp].<n>.bin with\n"
+		"                  seed incremented by <n> (default: 1)\n"
+		"  -s <suite>      Run only specified suite: 'csum' or 'eepmap'\n"
+		"  -S <seed>       Synthetic data seed (default: 1)\n"
+		"  -t <ms>         Minimal duration of each test (default: 200 ms)\n"
+		"  -v              Be verbose\n",
+		name, name
+	);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *corpus = NULL, *gendir = NULL, *suite = NULL;
+	int json = 0, gennum = 1, opt, i, ret = 0;
+
+	while ((opt = getopt(argc, argv, "c:g:hjn:s:S:t:v")) != -1) {
+		switch (opt) {
+		case 'c':
+			corpus = optarg;
+			break;
+		case 'g':
+			gendir = optarg;
+			break;
+		case 'n':
+			gennum = atoi(optarg);
+			break;
+		case 'S':
+			bench_seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'j':
+			json = 1;
+			break;
+		case 's':
+			suite = optarg;
+			break;
+		case 't':
+			bench_min_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+			break;
+		case 'v':
+			bench_verbose++;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (gendir)
+		return bench_gen_corpus(gendir, gennum) ? EXIT_FAILURE :
+							  EXIT_SUCCESS;
+
+	if (!suite || strcmp(suite, "csum") == 0)
+		ret |= bench_csum();
+	if (!suite || strcmp(suite, "eepmap") == 0)
+		for (i = 0; i < ARRAY_SIZE(bench_eepmaps); ++i)
+			ret |= bench_eepmap(bench_eepmaps[i], corpus);
+
+	if (json)
+		bench_print_json();
+	else
+		bench_print_table();
+
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "atheepmgr.h"
+#include "agent.h"
+
+/**
+ * Agent connector interacts with a card via a remote agent (see agent.c),
+ * which is reachable via a pair of file descriptors (e.g. pipes to a serial
+ * console or ssh session) or via a Unix socket. To minimize a number of round
+ * trips, registers writes are queued and sent in a batch with the next
+ * request, which needs a response, EEPROM and OTP are read by blocks, and
+ * hw_wait() polling is performed by the agent.
+ */
+
+#define AGENT_TX_SZ		0x10000
+#define AGENT_EEP_BLOCK		256	/* Words */
+#define AGENT_OTP_BLOCK		256	/* Bytes */
+
+struct agent_priv {
+	int in_fd;
+	int out_fd;
+	bool is_sock;
+	bool broken;		/* Stop any communication after I/O error */
+	uint8_t *tx;		/* Queued requests */
+	size_t tx_len;
+	size_t tx_last;		/* Offset of the last queued posted request */
+	unsigned long ntrips;
+	uint16_t eep_cache[AGENT_EEP_BLOCK];
+	uint32_t eep_base;
+	bool eep_valid;
+	uint8_t otp_cache[AGENT_OTP_BLOCK];
+	uint32_t otp_base;
+	bool otp_valid;
+};
+
+static bool agent_io(int fd, void *buf, size_t len, bool wr)
+{
+	ssize_t res;
+
+	while (len) {
+		res = wr ? write(fd, buf, len) : read(fd, buf, len);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return false;
+		buf += res;
+		len -= res;
+	}
+
+	return true;
+}
+
+static int agent_flush(struct agent_priv *apd)
+{
+	bool res;
+
+	if (apd->broken)
+		return -EIO;
+	if (!apd->tx_len)
+		return 0;
+
+	res = agent_io(apd->out_fd, apd->tx, apd->tx_len, true);
+	apd->tx_len = 0;
+	apd->tx_last = SIZE_MAX;
+	if (!res) {
+		fprintf(stderr, "conagent: unable to send requests: %s\n",
+			strerror(errno));
+		apd->broken = true;
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/* Append request to the queue, consecutive posted requests are merged */
+static int agent_queue(struct agent_priv *apd, uint8_t op, uint16_t num,
+		       uint32_t addr, const void *payload, size_t plen)
+{
+	struct agent_req *req;
+	int err;
+
+	if (apd->tx_len + sizeof(*req) + plen > AGENT_TX_SZ) {
+		err = agent_flush(apd);
+		if (err)
+			return err;
+	}
+
+	if (apd->tx_last != SIZE_MAX) {
+		req = (struct agent_req *)(apd->tx + apd->tx_last);
+		if (req->op == op && le16toh(req->num) + num <= AGENT_NUM_MAX) {
+			req->num = htole16(le16toh(req->num) + num);
+			goto append;
+		}
+	}
+
+	req = (struct agent_req *)(apd->tx + apd->tx_len);
+	req->op = op;
+	req->__pad = 0;
+	req->num = htole16(num);
+	req->addr = htole32(addr);
+	if (op == AGENT_OP_REG_WRITE || op == AGENT_OP_REG_RMW)
+		apd->tx_last = apd->tx_len;
+	else
+		apd->tx_last = SIZE_MAX;
+	apd->tx_len += sizeof(*req);
+
+append:
+	memcpy(apd->tx + apd->tx_len, payload, plen);
+	apd->tx_len += plen;
+
+	return 0;
+}
+
+/* Send request with all queued ones and receive the response */
+static int agent_call(struct agent_priv *apd, uint8_t op, uint16_t num,
+		      uint32_t addr, const void *payload, size_t plen,
+		      void *out, uint32_t olen)
+{
+	struct agent_resp resp;
+	uint32_t len;
+	int err;
+
+	err = agent_queue(apd, op, num, addr, payload, plen);
+	if (!err)
+		err = agent_flush(apd);
+	if (err)
+		return err;
+
+	apd->ntrips++;
+
+	if (!agent_io(apd->in_fd, &resp, sizeof(resp), false))
+		goto err_io;
+	len = le32toh(resp.len);
+	if (len > olen) {
+		fprintf(stderr, "conagent: unexpected response length %u\n",
+			len);
+		apd->broken = true;	/* Stream is out of sync */
+		return -EPROTO;
+	}
+	if (len && !agent_io(apd->in_fd, out, len, false))
+		goto err_io;
+
+	return (int32_t)le32toh(resp.status);
+
+err_io:
+	fprintf(stderr, "conagent: unable to receive response\n");
+	apd->broken = true;
+
+	return -EIO;
+}
+
+static uint32_t agent_reg_read(struct atheepmgr *aem, uint32_t reg)
+{
+	struct agent_priv *apd = aem->con_priv;
+	uint32_t addr = htole32(reg), val;
+
+	if (agent_call(apd, AGENT_OP_REG_READ, 1, 0, &addr, sizeof(addr),
+		       &val, sizeof(val)) != 0) {
+		hw_io_error(aem);
+		return ~0;
+	}
+
+	return le32toh(val);
+}
+
+static void agent_reg_write(struct atheepmgr *aem, uint32_t reg, uint32_t val)
+{
+	struct agent_priv *apd = aem->con_priv;
+	uint32_t data[2] = {htole32(reg), htole32(val)};
+
+	agent_queue(apd, AGENT_OP_REG_WRITE, 1, 0, data, sizeof(data));
+}
+
+static void agent_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
+			  uint32_t clr)
+{
+	struct agent_priv *apd = aem->con_priv;
+	uint32_t data[3] = {htole32(reg), htole32(set), htole32(clr)};
+
+	agent_queue(apd, AGENT_OP_REG_RMW, 1, 0, data, sizeof(data));
+}
+
+static int agent_reg_bulk_read(struct atheepmgr *aem, uint32_t reg,
+			       uint32_t *vals, unsigned int num)
+{
+	struct agent_priv *apd = aem->con_priv;
+	unsigned int i, n;
+	int err;
+
+	for (i = 0; i < num; i += n) {
+		n = num - i < AGENT_NUM_MAX ? num - i : AGENT_NUM_MAX;
+		err = agent_call(apd, AGENT_OP_REG_BULK, n,
+				 reg + i * sizeof(uint32_t), NULL, 0,
+				 &vals[i], n * sizeof(uint32_t));
+		if (err)
+			return err;
+	}
+
+	for (i = 0; i < num; ++i)
+		vals[i] = le32toh(vals[i]);
+
+	return 0;
+}
+
+static bool agent_wait(struct atheepmgr *aem, uint32_t reg, uint32_t mask,
+		       uint32_t val, uint32_t timeout)
+{
+	struct agent_priv *apd = aem->con_priv;
+	uint32_t data[3] = {htole32(mask), htole32(val), htole32(timeout)};
+
+	return agent_call(apd, AGENT_OP_WAIT, 0, reg, data, sizeof(data),
+			  NULL, 0) == 0;
+}
+
+static bool agent_eeprom_read(struct atheepmgr *aem, uint32_t off,
+			      uint16_t *data)
+{
+	struct agent_priv *apd = aem->con_priv;
+	uint32_t base = off - off % AGENT_EEP_BLOCK;
+
+	if (!apd->eep_valid || apd->eep_base != base) {
+		apd->eep_valid = false;
+		if (agent_call(apd, AGENT_OP_EEP_READ, AGENT_EEP_BLOCK, base,
+			       NULL, 0, apd->eep_cache,
+			       sizeof(apd->eep_cache)) != 0) {
+			hw_io_error(aem);
+			return false;
+		}
+		apd->eep_base = base;
+		apd->eep_valid = true;
+	}
+
+	*data = le16toh(apd->eep_cache[off - base]);
+
+	return true;
+}
+
+static bool agent_eeprom_write(struct atheepmgr *aem, uint32_t off,
+			       uint16_t data)
+{
+	struct agent_priv *apd = aem->con_priv;
+	uint16_t word = htole16(data);
+
+	/* Forget cached block, since written data could be not stored */
+	if (apd->eep_valid && off - apd->eep_base < AGENT_EEP_BLOCK)
+		apd->eep_valid = false;
+
+	return agent_call(apd, AGENT_OP_EEP_WRITE, 1, off, &word,
+			  sizeof(word), NULL, 0) == 0;
+}
+
+static void agent_eeprom_lock(struct atheepmgr *aem, int lock)
+{
+	struct agent_priv *apd = aem->con_priv;
+
+	agent_call(apd, AGENT_OP_EEP_LOCK, 0, lock, NULL, 0, NULL, 0);
+}
+
+static bool agent_otp_enable(struct atheepmgr *aem, int enable)
+{
+	struct agent_priv *apd = aem->con_priv;
+
+	return agent_call(apd, AGENT_OP_OTP_ENABLE, 0, enable, NULL, 0,
+			  NULL, 0) == 0;
+}
+
+static bool agent_otp_read(struct atheepmgr *aem, uint32_t off, uint8_t *data)
+{
+	struct agent_priv *apd = aem->con_priv;
+	uint32_t base = off - off % AGENT_OTP_BLOCK;
+
+	if (!apd->otp_valid || apd->otp_base != base) {
+		apd->otp_valid = false;
+		if (agent_call(apd, AGENT_OP_OTP_READ, AGENT_OTP_BLOCK, base,
+			       NULL, 0, apd->otp_cache,
+			       sizeof(apd->otp_cache)) != 0) {
+			hw_io_error(aem);
+			return false;
+		}
+		apd->otp_base = base;
+		apd->otp_valid = true;
+	}
+
+	*data = apd->otp_cache[off - base];
+
+	return true;
+}
+
+static int agent_connect(struct agent_priv *apd, const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "conagent: socket path is too long -- %s\n",
+			path);
+		return -EINVAL;
+	}
+	strcpy(addr.sun_path, path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 ||
+	    connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		fprintf(stderr, "conagent: unable to connect to %s: %s\n",
+			path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -ENOTCONN;
+	}
+
+	apd->in_fd = apd->out_fd = fd;
+	apd->is_sock = true;
+
+	return 0;
+}
+
+static int agent_init(struct atheepmgr *aem, const char *arg_str)
+{
+	struct agent_priv *apd = aem->con_priv;
+	unsigned long in, out;
+	uint32_t ver;
+	char *endp;
+	int err;
+
+	memset(apd, 0x00, sizeof(*apd));
+	apd->tx_last = SIZE_MAX;
+
+	/* Either a pair of descriptors or a socket path */
+	errno = 0;
+	in = strtoul(arg_str, &endp, 10);
+	if (!errno && endp != arg_str && *endp == ':') {
+		out = strtoul(endp + 1, &endp, 10);
+		if (errno || *endp != '\0' || in > INT32_MAX ||
+		    out > INT32_MAX) {
+			fprintf(stderr, "conagent: invalid descriptors specification -- %s\n",
+				arg_str);
+			return -EINVAL;
+		}
+		apd->in_fd = in;
+		apd->out_fd = out;
+	} else {
+		err = agent_connect(apd, arg_str);
+		if (err)
+			return err;
+	}
+
+	apd->tx = malloc(AGENT_TX_SZ);
+	if (!apd->tx) {
+		fprintf(stderr, "conagent: unable to allocate requests buffer\n");
+		err = -ENOMEM;
+		goto err;
+	}
+
+	err = agent_call(apd, AGENT_OP_HELLO, 0, 0, NULL, 0, &ver,
+			 sizeof(ver));
+	if (err) {
+		fprintf(stderr, "conagent: agent does not respond\n");
+		goto err;
+	}
+	if (le32toh(ver) != AGENT_PROTO_VER) {
+		fprintf(stderr, "conagent: unsupported agent protocol version %u, expect %u\n",
+			le32toh(ver), AGENT_PROTO_VER);
+		err = -EPROTO;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	free(apd->tx);
+	if (apd->is_sock)
+		close(apd->in_fd);
+
+	return err;
+}
+
+static void agent_clean(struct atheepmgr *aem)
+{
+	struct agent_priv *apd = aem->con_priv;
+
+	agent_flush(apd);	/* Send posted requests */
+
+	if (aem->verbose)
+		printf("conagent: %lu round trip(s)\n", apd->ntrips);
+
+	free(apd->tx);
+	if (apd->is_sock)
+		close(apd->in_fd);
+}
+
+static const struct eep_ops eep_agent = {
+	.read = agent_eeprom_read,
+	.write = agent_eeprom_write,
+	.lock = agent_eeprom_lock,
+};
+
+static const struct otp_ops otp_agent = {
+	.enable = agent_otp_enable,
+	.read = agent_otp_read,
+};
+
+const struct connector con_agent = {
+	.name = "Agent",
+	.priv_data_sz = sizeof(struct agent_priv),
+	.caps = CON_CAP_HW,
+	.init = agent_init,
+	.clean = agent_clean,
+	.reg_read = agent_reg_read,
+	.reg_write = agent_reg_write,
+	.reg_rmw = agent_reg_rmw,
+	.reg_bulk_read = agent_reg_bulk_read,
+	.wait = agent_wait,
+	.eep = &eep_agent,
+	.otp = &otp_agent,
+};
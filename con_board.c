@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#include "atheepmgr.h"
+
+/**
+ * Board data container (ath10k board-2.bin) connector. The container file is
+ * mapped to memory and an index of boards is built on initialization, then
+ * the selected board data are served as a blob directly from the mapping.
+ *
+ * Container consists of a magic string followed by a sequence of IEs (type,
+ * length, data padded to 4 bytes). Each board IE contains one or more name
+ * IEs followed by a data IE, each name makes a separate index entry.
+ */
+
+#define BOARD_MAGIC			"QCA-ATH10K-BOARD"
+
+#define BOARD_IE_BOARD			0
+#define BOARD_IE_BOARD_EXT		1
+
+#define BOARD_IE_BOARD_NAME		0
+#define BOARD_IE_BOARD_DATA		1
+
+#define BOARD_ALIGN(__len)		(((__len) + 3) & ~3)
+
+struct board_ie_hdr {
+	uint32_t id;		/* Little-endian */
+	uint32_t len;		/* Little-endian */
+	uint8_t data[];
+} __attribute__ ((packed));
+
+struct board_entry {
+	const char *name;	/* Not null terminated */
+	uint32_t name_len;
+	const uint8_t *data;
+	uint32_t data_len;
+};
+
+struct board_priv {
+	uint8_t *map;
+	size_t map_sz;
+	struct board_entry *ents;
+	unsigned int nents;
+	unsigned int cur;	/* Selected entry */
+	bool all;		/* Iterate over all entries */
+};
+
+static uint32_t board_reg_read(struct atheepmgr *aem, uint32_t reg)
+{
+	fprintf(stderr, "conboard: direct reg access is not supported\n");
+
+	return 0;
+}
+
+static void board_reg_write(struct atheepmgr *aem, uint32_t reg,
+			    uint32_t val)
+{
+	fprintf(stderr, "conboard: direct reg write is not supported\n");
+}
+
+static void board_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
+			  uint32_t clr)
+{
+	fprintf(stderr, "conboard: direct reg RMW is not supported\n");
+}
+
+static int board_blob_getsize(struct atheepmgr *aem)
+{
+	struct board_priv *bpd = aem->con_priv;
+
+	return bpd->ents[bpd->cur].data_len;
+}
+
+static int board_blob_read(struct atheepmgr *aem, void *buf, int len)
+{
+	struct board_priv *bpd = aem->con_priv;
+	const struct board_entry *ent = &bpd->ents[bpd->cur];
+
+	if (len > ent->data_len)
+		len = ent->data_len;
+	memcpy(buf, ent->data, len);
+
+	return len;
+}
+
+static void board_entry_print(struct atheepmgr *aem, unsigned int idx)
+{
+	struct board_priv *bpd = aem->con_priv;
+	const struct board_entry *ent = &bpd->ents[idx];
+
+	printf("Board #%u: %.*s (%u bytes at 0x%06x)\n", idx,
+	       (int)ent->name_len, ent->name ? ent->name : "<noname>",
+	       ent->data_len, (unsigned int)(ent->data - bpd->map));
+}
+
+static int board_entry_add(struct board_priv *bpd,
+			   const struct board_ie_hdr *name,
+			   const struct board_ie_hdr *data)
+{
+	struct board_entry *ent;
+
+	if (bpd->nents % 64 == 0) {
+		ent = realloc(bpd->ents, (bpd->nents + 64) * sizeof(*ent));
+		if (!ent)
+			return -ENOMEM;
+		bpd->ents = ent;
+	}
+
+	ent = &bpd->ents[bpd->nents++];
+	ent->name = name ? (const char *)name->data : NULL;
+	ent->name_len = name ? le32toh(name->len) : 0;
+	ent->data = data->data;
+	ent->data_len = le32toh(data->len);
+
+	return 0;
+}
+
+/* Iterate over IEs, returns NULL on the end or on a truncated IE */
+static const struct board_ie_hdr *board_ie_next(const uint8_t **pos,
+						const uint8_t *end)
+{
+	const struct board_ie_hdr *ie = (const void *)*pos;
+	uint32_t len;
+
+	if (end - *pos < sizeof(*ie))
+		return NULL;
+	len = le32toh(ie->len);
+	if (end - ie->data < len)
+		return NULL;
+	*pos = ie->data + BOARD_ALIGN(len) < end ?
+	       ie->data + BOARD_ALIGN(len) : end;
+
+	return ie;
+}
+
+static int board_index_build(struct board_priv *bpd)
+{
+	const struct board_ie_hdr *ie, *sub, *names[16];
+	const uint8_t *pos, *end, *spos, *send;
+	unsigned int nnames, i;
+	int err;
+
+	pos = bpd->map + BOARD_ALIGN(sizeof(BOARD_MAGIC));
+	end = bpd->map + bpd->map_sz;
+
+	while ((ie = board_ie_next(&pos, end)) != NULL) {
+		if (le32toh(ie->id) != BOARD_IE_BOARD)
+			continue;	/* Skip extended board data */
+
+		nnames = 0;
+		spos = ie->data;
+		send = ie->data + le32toh(ie->len);
+		while ((sub = board_ie_next(&spos, send)) != NULL) {
+			if (le32toh(sub->id) == BOARD_IE_BOARD_NAME) {
+				if (nnames < ARRAY_SIZE(names))
+					names[nnames++] = sub;
+				continue;
+			}
+			if (le32toh(sub->id) != BOARD_IE_BOARD_DATA)
+				continue;
+			if (!nnames) {
+				err = board_entry_add(bpd, NULL, sub);
+				if (err)
+					return err;
+			}
+			for (i = 0; i < nnames; ++i) {
+				err = board_entry_add(bpd, names[i], sub);
+				if (err)
+					return err;
+			}
+			nnames = 0;
+		}
+	}
+
+	return 0;
+}
+
+static int board_select(struct atheepmgr *aem, const char *sel)
+{
+	struct board_priv *bpd = aem->con_priv;
+	const struct board_entry *ent;
+	unsigned long idx;
+	char *endp;
+	int i;
+
+	if (!sel || strcmp(sel, "all") == 0) {
+		bpd->all = true;
+		bpd->cur = 0;
+		return 0;
+	}
+
+	errno = 0;
+	idx = strtoul(sel, &endp, 10);
+	if (!errno && endp != sel && *endp == '\0') {
+		if (idx >= bpd->nents) {
+			fprintf(stderr, "conboard: board index %lu is out of range 0...%u\n",
+				idx, bpd->nents - 1);
+			return -EINVAL;
+		}
+		bpd->cur = idx;
+		return 0;
+	}
+
+	for (i = 0; i < bpd->nents; ++i) {
+		ent = &bpd->ents[i];
+		if (ent->name && ent->name_len == strlen(sel) &&
+		    memcmp(ent->name, sel, ent->name_len) == 0) {
+			bpd->cur = i;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "conboard: board '%s' is not found, use -v to see all boards\n",
+		sel);
+
+	return -ENOENT;
+}
+
+static int board_init(struct atheepmgr *aem, const char *arg_str)
+{
+	struct board_priv *bpd = aem->con_priv;
+	const char *sel = NULL;
+	struct stat st;
+	char *path, *p;
+	int fd, i, err;
+
+	memset(bpd, 0x00, sizeof(*bpd));
+
+	path = strdup(arg_str);
+	if (!path) {
+		fprintf(stderr, "conboard: unable to allocate memory for the path\n");
+		return -ENOMEM;
+	}
+	p = strrchr(path, ':');
+	if (p) {
+		*p = '\0';
+		sel = p + 1;
+	}
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "conboard: can not open '%s': %s\n", path,
+			strerror(errno));
+		err = -errno;
+		goto err_free;
+	}
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "conboard: can not stat '%s': %s\n", path,
+			strerror(errno));
+		err = -errno;
+		goto err_close;
+	}
+	bpd->map_sz = st.st_size;
+	if (bpd->map_sz < BOARD_ALIGN(sizeof(BOARD_MAGIC))) {
+		fprintf(stderr, "conboard: '%s' is too short for a board container\n",
+			path);
+		err = -EINVAL;
+		goto err_close;
+	}
+
+	bpd->map = mmap(NULL, bpd->map_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (bpd->map == MAP_FAILED) {
+		fprintf(stderr, "conboard: unable to map '%s': %s\n", path,
+			strerror(errno));
+		err = -errno;
+		goto err_close;
+	}
+	close(fd);
+	fd = -1;
+
+	if (memcmp(bpd->map, BOARD_MAGIC, sizeof(BOARD_MAGIC)) != 0) {
+		fprintf(stderr, "conboard: '%s' is not a board container, invalid magic\n",
+			path);
+		err = -EINVAL;
+		goto err_unmap;
+	}
+
+	err = board_index_build(bpd);
+	if (err) {
+		fprintf(stderr, "conboard: unable to allocate memory for the boards index\n");
+		goto err_unmap;
+	}
+	if (!bpd->nents) {
+		fprintf(stderr, "conboard: '%s' does not contain any board data\n",
+			path);
+		err = -ENOENT;
+		goto err_unmap;
+	}
+
+	if (aem->verbose) {
+		printf("conboard: container contains %u board(s):\n",
+		       bpd->nents);
+		for (i = 0; i < bpd->nents; ++i)
+			board_entry_print(aem, i);
+	}
+
+	err = board_select(aem, sel);
+	if (err)
+		goto err_unmap;
+
+	if (bpd->all || aem->verbose)
+		board_entry_print(aem, bpd->cur);
+
+	free(path);
+
+	return 0;
+
+err_unmap:
+	free(bpd->ents);
+	munmap(bpd->map, bpd->map_sz);
+err_close:
+	if (fd >= 0)
+		close(fd);
+err_free:
+	free(path);
+
+	return err;
+}
+
+static int board_next(struct atheepmgr *aem)
+{
+	struct board_priv *bpd = aem->con_priv;
+
+	if (!bpd->all || bpd->cur + 1 >= bpd->nents)
+		return -ENOENT;
+
+	bpd->cur++;
+	printf("\n");
+	board_entry_print(aem, bpd->cur);
+
+	return 0;
+}
+
+static void board_clean(struct atheepmgr *aem)
+{
+	struct board_priv *bpd = aem->con_priv;
+
+	free(bpd->ents);
+	munmap(bpd->map, bpd->map_sz);
+}
+
+static const struct blob_ops blob_board = {
+	.getsize = board_blob_getsize,
+	.read = board_blob_read,
+};
+
+const struct connector con_board = {
+	.name = "Board",
+	.priv_data_sz = sizeof(struct board_priv),
+	.init = board_init,
+	.clean = board_clean,
+	.next = board_next,
+	.reg_read = board_reg_read,
+	.reg_write = board_reg_write,
+	.reg_rmw = board_reg_rmw,
+	.blob = &blob_board,
+};
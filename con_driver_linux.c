@@ -18,6 +18,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 
 #include "atheepmgr.h"
 
@@ -26,11 +27,20 @@
 #define DEBUGFS_PATH "/sys/kernel/debug"
 #define DEBUGFS_CFG80211_PATH DEBUGFS_PATH "/ieee80211"
 
+struct driver_uring;
+
 struct driver_priv {
 	char *regidx_fname;
 	char *regval_fname;
+	int regidx_fd;
+	int regval_fd;
 	const char *regval_fmt;
 	int regval_strlen;
+	struct driver_uring *uring;	/* Optional asynchronous I/O backend */
+	char *regdump_fname;	/* Optional registers dump file */
+	char *caldata_fname;	/* Optional calibration data file */
+	uint8_t *blob_buf;	/* Fetched calibration data */
+	int blob_len;		/* Calibration data length, -1 if not fetched */
 };
 
 static const char * const driver_ath9k_names[] = {
@@ -52,6 +62,8 @@ static const struct driver_info {
 		const char * const regval_fname;
 		const char * const regval_fmt;
 		int regval_strlen;
+		const char * const regdump_fname;
+		const char * const caldata_fname;
 	} debugfs;
 } driver_infos[] = {
 	{
@@ -62,6 +74,7 @@ static const struct driver_info {
 			.regval_fname = "regval",
 			.regval_fmt = "0x%8x%n",
 			.regval_strlen = 10,
+			.regdump_fname = "regdump",
 		},
 	}, {
 		.name = "ath10k",
@@ -71,51 +84,39 @@ static const struct driver_info {
 			.regval_fname = "reg_value",
 			.regval_fmt = "0x%*8x:0x%8x%n",
 			.regval_strlen = 21,
+			.caldata_fname = "cal_data",
 		},
 	}
 };
 
+/**
+ * Both register address and value files are kept opened during the whole
+ * session and are accessed with positioned I/O, since the driver generates
+ * the file contents on each read and does not care about the position.
+ */
 static int __regidx_write(struct atheepmgr *aem, uint32_t reg)
 {
 	struct driver_priv *dpd = aem->con_priv;
-	FILE *fp = fopen(dpd->regidx_fname, "w");
+	char buf[0x10];
 
-	if (!fp) {
-		fprintf(stderr, "condriver: unable to open %s for writing: %s\n",
-			dpd->regidx_fname, strerror(errno));
-		return -1;
-	}
-	if (fprintf(fp, "0x%08x\n", reg) != 11) {
+	snprintf(buf, sizeof(buf), "0x%08x\n", reg);
+	if (pwrite(dpd->regidx_fd, buf, 11, 0) != 11) {
 		fprintf(stderr, "condriver: unable to write register address: %s\n",
 			strerror(errno));
-		fclose(fp);
 		return -1;
 	}
-	fclose(fp);
 
 	return 0;
 }
 
-static int __regval_read(struct atheepmgr *aem, uint32_t *pval)
+static int __regval_parse(struct atheepmgr *aem, const char *buf,
+			  uint32_t *pval)
 {
 	struct driver_priv *dpd = aem->con_priv;
-	FILE *fp = fopen(dpd->regval_fname, "r");
 	unsigned int v;
-	int n, l;
+	int n, l = 0;
 
-	if (!fp) {
-		fprintf(stderr, "condriver: unable to open %s for reading: %s\n",
-			dpd->regval_fname, strerror(errno));
-		return -1;
-	}
-	n = fscanf(fp, dpd->regval_fmt, &v, &l);
-	if (ferror(fp)) {
-		fprintf(stderr, "condriver: unable to read register value file: %s\n",
-			strerror(errno));
-		fclose(fp);
-		return -1;
-	}
-	fclose(fp);
+	n = sscanf(buf, dpd->regval_fmt, &v, &l);
 	if (n != 1 || l != dpd->regval_strlen) {
 		fprintf(stderr, "condriver: unexpected register value format\n");
 		return -1;
@@ -125,31 +126,283 @@ static int __regval_read(struct atheepmgr *aem, uint32_t *pval)
 	return 0;
 }
 
-static int __regval_write(struct atheepmgr *aem, uint32_t val)
+static int __regval_read(struct atheepmgr *aem, uint32_t *pval)
 {
 	struct driver_priv *dpd = aem->con_priv;
-	FILE *fp = fopen(dpd->regval_fname, "w");
+	char buf[0x40];
+	ssize_t n;
 
-	if (!fp) {
-		fprintf(stderr, "condriver: unable to open %s for writing: %s\n",
-			dpd->regval_fname, strerror(errno));
+	n = pread(dpd->regval_fd, buf, sizeof(buf) - 1, 0);
+	if (n < 0) {
+		fprintf(stderr, "condriver: unable to read register value file: %s\n",
+			strerror(errno));
 		return -1;
 	}
-	if (fprintf(fp, "0x%08x\n", val) != 11) {
+	buf[n] = '\0';
+
+	return __regval_parse(aem, buf, pval);
+}
+
+static int __regval_write(struct atheepmgr *aem, uint32_t val)
+{
+	struct driver_priv *dpd = aem->con_priv;
+	char buf[0x10];
+
+	snprintf(buf, sizeof(buf), "0x%08x\n", val);
+	if (pwrite(dpd->regval_fd, buf, 11, 0) != 11) {
 		fprintf(stderr, "condriver: unable to write register value: %s\n",
 			strerror(errno));
-		fclose(fp);
 		return -1;
 	}
-	fclose(fp);
 
 	return 0;
 }
 
+#if defined(CONFIG_CON_DRIVER_URING)
+/**
+ * io_uring backend submits the register address write and the value read as
+ * a linked pair, so a register read costs a single syscall instead of two.
+ * Pairs for consecutive registers are linked into one chain and submitted at
+ * once. Pairs are never executed in parallel, since the register address is
+ * a shared driver state, which should not be changed until the value is read.
+ * Values are parsed as completions are reaped.
+ *
+ * Raw syscalls are used to avoid an extra library dependency. If the kernel
+ * does not support io_uring or its operations (e.g. IORING_OP_READ and
+ * IORING_OP_WRITE before 5.6), the backend is disabled on the first failure
+ * and the synchronous path is used.
+ */
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define URING_PAIRS		32	/* Max number of pairs per submission */
+
+struct driver_uring {
+	int fd;
+	void *sq_ring;
+	size_t sq_ring_sz;
+	void *cq_ring;
+	size_t cq_ring_sz;
+	struct io_uring_sqe *sqes;
+	size_t sqes_sz;
+	unsigned int *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	char idx[URING_PAIRS][0x10];
+	char val[URING_PAIRS][0x40];
+};
+
+static void driver_uring_clean(struct driver_uring *ur)
+{
+	if (ur->sqes && ur->sqes != MAP_FAILED)
+		munmap(ur->sqes, ur->sqes_sz);
+	if (ur->cq_ring && ur->cq_ring != MAP_FAILED &&
+	    ur->cq_ring != ur->sq_ring)
+		munmap(ur->cq_ring, ur->cq_ring_sz);
+	if (ur->sq_ring && ur->sq_ring != MAP_FAILED)
+		munmap(ur->sq_ring, ur->sq_ring_sz);
+	if (ur->fd >= 0)
+		close(ur->fd);
+	free(ur);
+}
+
+static struct driver_uring *driver_uring_init(struct atheepmgr *aem)
+{
+	struct io_uring_params p;
+	struct driver_uring *ur;
+
+	ur = calloc(1, sizeof(*ur));
+	if (!ur)
+		return NULL;
+
+	memset(&p, 0x00, sizeof(p));
+	ur->fd = syscall(__NR_io_uring_setup, URING_PAIRS * 2, &p);
+	if (ur->fd < 0) {
+		if (aem->verbose)
+			printf("condriver: io_uring is not available: %s\n",
+			       strerror(errno));
+		goto err;
+	}
+
+	ur->sq_ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ur->cq_ring_sz = p.cq_off.cqes +
+			 p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ur->cq_ring_sz > ur->sq_ring_sz)
+			ur->sq_ring_sz = ur->cq_ring_sz;
+		ur->cq_ring_sz = ur->sq_ring_sz;
+	}
+	ur->sq_ring = mmap(NULL, ur->sq_ring_sz, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, ur->fd,
+			   IORING_OFF_SQ_RING);
+	if (ur->sq_ring == MAP_FAILED)
+		goto err;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ur->cq_ring = ur->sq_ring;
+	} else {
+		ur->cq_ring = mmap(NULL, ur->cq_ring_sz, PROT_READ | PROT_WRITE,
+				   MAP_SHARED | MAP_POPULATE, ur->fd,
+				   IORING_OFF_CQ_RING);
+		if (ur->cq_ring == MAP_FAILED)
+			goto err;
+	}
+	ur->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+	ur->sqes = mmap(NULL, ur->sqes_sz, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, ur->fd, IORING_OFF_SQES);
+	if (ur->sqes == MAP_FAILED)
+		goto err;
+
+	ur->sq_tail = ur->sq_ring + p.sq_off.tail;
+	ur->sq_mask = ur->sq_ring + p.sq_off.ring_mask;
+	ur->sq_array = ur->sq_ring + p.sq_off.array;
+	ur->cq_head = ur->cq_ring + p.cq_off.head;
+	ur->cq_tail = ur->cq_ring + p.cq_off.tail;
+	ur->cq_mask = ur->cq_ring + p.cq_off.ring_mask;
+	ur->cqes = ur->cq_ring + p.cq_off.cqes;
+
+	if (aem->verbose)
+		printf("condriver: use io_uring for registers reading\n");
+
+	return ur;
+
+err:
+	driver_uring_clean(ur);
+
+	return NULL;
+}
+
+static void driver_uring_prep(struct driver_uring *ur, unsigned int *tail,
+			      int op, int fd, void *buf, unsigned int len,
+			      uint64_t user_data, bool link)
+{
+	unsigned int idx = *tail & *ur->sq_mask;
+	struct io_uring_sqe *sqe = &ur->sqes[idx];
+
+	memset(sqe, 0x00, sizeof(*sqe));
+	sqe->opcode = op;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = 0;
+	sqe->flags = link ? IOSQE_IO_LINK : 0;
+	sqe->user_data = user_data;
+	ur->sq_array[idx] = idx;
+	(*tail)++;
+}
+
+static int __driver_uring_read(struct atheepmgr *aem, uint32_t reg,
+			       uint32_t *vals, unsigned int num)
+{
+	struct driver_priv *dpd = aem->con_priv;
+	struct driver_uring *ur = dpd->uring;
+	unsigned int i, n, tail, head, reaped;
+	unsigned int submitted, vlen;
+	struct io_uring_cqe *cqe;
+	int ret, err = 0;
+
+	for (; num; num -= n, vals += n, reg += n * sizeof(uint32_t)) {
+		n = num < URING_PAIRS ? num : URING_PAIRS;
+
+		/*
+		 * Value is read with its exact length, since a short read
+		 * breaks the link and cancels all the subsequent pairs.
+		 */
+		vlen = dpd->regval_strlen + 1;	/* With the trailing '\n' */
+		tail = *ur->sq_tail;
+		for (i = 0; i < n; ++i) {
+			snprintf(ur->idx[i], sizeof(ur->idx[i]), "0x%08x\n",
+				 (unsigned int)(reg + i * sizeof(uint32_t)));
+			driver_uring_prep(ur, &tail, IORING_OP_WRITE,
+					  dpd->regidx_fd, ur->idx[i], 11,
+					  i * 2, true);
+			driver_uring_prep(ur, &tail, IORING_OP_READ,
+					  dpd->regval_fd, ur->val[i], vlen,
+					  i * 2 + 1, i != n - 1);
+		}
+		__atomic_store_n(ur->sq_tail, tail, __ATOMIC_RELEASE);
+
+		ret = syscall(__NR_io_uring_enter, ur->fd, n * 2, n * 2,
+			      IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			err = -errno;
+			submitted = 0;
+		} else {
+			submitted = ret;
+			if (submitted != n * 2)
+				err = -EIO;
+		}
+
+		/*
+		 * Reap completions and parse read values as they arrive, on
+		 * error still drain all submitted entries.
+		 */
+		head = *ur->cq_head;
+		for (reaped = 0; reaped < submitted;) {
+			if (head == __atomic_load_n(ur->cq_tail,
+						    __ATOMIC_ACQUIRE)) {
+				ret = syscall(__NR_io_uring_enter, ur->fd, 0, 1,
+					      IORING_ENTER_GETEVENTS, NULL, 0);
+				if (ret < 0 && errno != EINTR) {
+					err = -errno;
+					break;
+				}
+				continue;
+			}
+			cqe = &ur->cqes[head & *ur->cq_mask];
+			i = cqe->user_data / 2;
+			if (cqe->res < 0) {
+				if (!err)
+					err = cqe->res;
+			} else if (cqe->user_data % 2 && !err) {
+				ur->val[i][cqe->res] = '\0';
+				if (__regval_parse(aem, ur->val[i], &vals[i]))
+					err = -EIO;
+			}
+			head++;
+			reaped++;
+		}
+		__atomic_store_n(ur->cq_head, head, __ATOMIC_RELEASE);
+
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+/* Read <num> consecutive registers, returns zero on success */
+static int driver_uring_read(struct atheepmgr *aem, uint32_t reg,
+			     uint32_t *vals, unsigned int num)
+{
+	struct driver_priv *dpd = aem->con_priv;
+	int ret;
+
+	ret = __driver_uring_read(aem, reg, vals, num);
+	if (ret) {
+		if (aem->verbose)
+			printf("condriver: io_uring read failed: %s, disable it\n",
+			       strerror(-ret));
+		driver_uring_clean(dpd->uring);
+		dpd->uring = NULL;
+	}
+
+	return ret;
+}
+#endif
+
 static uint32_t driver_reg_read(struct atheepmgr *aem, uint32_t reg)
 {
+	struct driver_priv *dpd = aem->con_priv;
 	uint32_t value = 0;
 
+#if defined(CONFIG_CON_DRIVER_URING)
+	if (dpd->uring && driver_uring_read(aem, reg, &value, 1) == 0)
+		return value;
+#else
+	(void)dpd;
+#endif
+
 	if (__regidx_write(aem, reg))
 		goto err;
 	if (__regval_read(aem, &value))
@@ -158,14 +411,15 @@ static uint32_t driver_reg_read(struct atheepmgr *aem, uint32_t reg)
 	return value;
 
 err:
+	hw_io_error(aem);
+
 	return 0;
 }
 
 static void driver_reg_write(struct atheepmgr *aem, uint32_t reg, uint32_t val)
 {
-	if (__regidx_write(aem, reg))
-		return;
-	__regval_write(aem, val);
+	if (__regidx_write(aem, reg) || __regval_write(aem, val))
+		hw_io_error(aem);
 }
 
 static void driver_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
@@ -173,15 +427,268 @@ static void driver_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
 {
 	uint32_t value = 0;
 
-	if (__regidx_write(aem, reg))
-		return;
-	if (__regval_read(aem, &value))
+	if (__regidx_write(aem, reg) || __regval_read(aem, &value)) {
+		hw_io_error(aem);
 		return;
+	}
 
 	value &= ~clr;
 	value |= set;
 
-	__regval_write(aem, value);
+	if (__regval_write(aem, value))
+		hw_io_error(aem);
+}
+
+/**
+ * Registers dump file contains a line per register in form of "<addr> <val>",
+ * so the whole window could be fetched by a single sequential read instead of
+ * a pair of the address write and the value read per register. If some of
+ * requested registers are not dumped by the driver, then they are read by the
+ * io_uring backend if it is available, otherwise the caller will fall back to
+ * the per register access.
+ */
+static int driver_reg_bulk_read(struct atheepmgr *aem, uint32_t reg,
+				uint32_t *vals, unsigned int num)
+{
+	struct driver_priv *dpd = aem->con_priv;
+	unsigned int addr, val, found = 0;
+	char line[0x40];
+	FILE *fp;
+
+	if (!dpd->regdump_fname)
+		goto no_regdump;
+
+	fp = fopen(dpd->regdump_fname, "r");
+	if (!fp) {
+		fprintf(stderr, "condriver: unable to open %s for reading: %s\n",
+			dpd->regdump_fname, strerror(errno));
+		goto no_regdump;
+	}
+
+	while (found < num && fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%x %x", &addr, &val) != 2)
+			continue;
+		if (addr < reg || addr % 4 != 0 ||
+		    (addr - reg) / sizeof(uint32_t) >= num)
+			continue;
+		vals[(addr - reg) / sizeof(uint32_t)] = val;
+		found++;
+	}
+	fclose(fp);
+
+	if (found == num)
+		return 0;
+
+no_regdump:
+#if defined(CONFIG_CON_DRIVER_URING)
+	if (dpd->uring)
+		return driver_uring_read(aem, reg, vals, num);
+#endif
+
+	return -EOPNOTSUPP;
+}
+
+/**
+ * Calibration data file is generated by the driver on opening, it has no size
+ * until it is read, so fetch its contents at once with a single sequential
+ * read and then serve the blob from memory.
+ */
+#define DRIVER_BLOB_MAX		0x10000
+
+static int driver_blob_fetch(struct atheepmgr *aem)
+{
+	struct driver_priv *dpd = aem->con_priv;
+	ssize_t res;
+	int fd;
+
+	if (dpd->blob_len >= 0)
+		return 0;
+	dpd->blob_len = 0;
+
+	if (!dpd->caldata_fname)
+		return 0;
+
+	dpd->blob_buf = malloc(DRIVER_BLOB_MAX);
+	if (!dpd->blob_buf) {
+		fprintf(stderr, "condriver: unable to allocate memory for calibration data\n");
+		return -ENOMEM;
+	}
+
+	fd = open(dpd->caldata_fname, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "condriver: unable to open %s for reading: %s\n",
+			dpd->caldata_fname, strerror(errno));
+		return -errno;
+	}
+	while (dpd->blob_len < DRIVER_BLOB_MAX) {
+		res = read(fd, dpd->blob_buf + dpd->blob_len,
+			   DRIVER_BLOB_MAX - dpd->blob_len);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res < 0) {
+			fprintf(stderr, "condriver: unable to read calibration data: %s\n",
+				strerror(errno));
+			dpd->blob_len = 0;
+			close(fd);
+			return -EIO;
+		}
+		if (res == 0)
+			break;
+		dpd->blob_len += res;
+	}
+	close(fd);
+
+	if (aem->verbose)
+		printf("condriver: fetched %d bytes of calibration data\n",
+		       dpd->blob_len);
+
+	return 0;
+}
+
+static int driver_blob_getsize(struct atheepmgr *aem)
+{
+	struct driver_priv *dpd = aem->con_priv;
+
+	if (driver_blob_fetch(aem))
+		return -1;
+
+	return dpd->blob_len;
+}
+
+static int driver_blob_read(struct atheepmgr *aem, void *buf, int len)
+{
+	struct driver_priv *dpd = aem->con_priv;
+
+	if (driver_blob_fetch(aem))
+		return -1;
+
+	if (len > dpd->blob_len)
+		len = dpd->blob_len;
+	memcpy(buf, dpd->blob_buf, len);
+
+	return len;
+}
+
+static char *driver_path(const char *dir, const char *fname)
+{
+	size_t len = strlen(dir) + 1 + strlen(fname) + 1;
+	char *path = malloc(len);
+
+	if (path)
+		snprintf(path, len, "%s/%s", dir, fname);
+
+	return path;
+}
+
+static void driver_files_clean(struct atheepmgr *aem)
+{
+	struct driver_priv *dpd = aem->con_priv;
+
+#if defined(CONFIG_CON_DRIVER_URING)
+	if (dpd->uring)
+		driver_uring_clean(dpd->uring);
+#endif
+	if (dpd->regidx_fd >= 0)
+		close(dpd->regidx_fd);
+	if (dpd->regval_fd >= 0)
+		close(dpd->regval_fd);
+	free(dpd->regidx_fname);
+	free(dpd->regval_fname);
+	free(dpd->regdump_fname);
+	free(dpd->caldata_fname);
+	free(dpd->blob_buf);
+}
+
+/* Open driver debug files, which are located in the <dir> directory */
+static int driver_files_init(struct atheepmgr *aem,
+			     const struct driver_info *di, const char *dir)
+{
+	struct driver_priv *dpd = aem->con_priv;
+	struct stat statbuf;
+
+	memset(dpd, 0x00, sizeof(*dpd));
+	dpd->regidx_fd = -1;
+	dpd->regval_fd = -1;
+	dpd->blob_len = -1;
+	dpd->regval_fmt = di->debugfs.regval_fmt;
+	dpd->regval_strlen = di->debugfs.regval_strlen;
+
+	dpd->regidx_fname = driver_path(dir, di->debugfs.regidx_fname);
+	dpd->regval_fname = driver_path(dir, di->debugfs.regval_fname);
+	if (!dpd->regidx_fname || !dpd->regval_fname) {
+		fprintf(stderr, "condriver: unable to allocate memory for register files paths\n");
+		goto err;
+	}
+
+	dpd->regidx_fd = open(dpd->regidx_fname, O_WRONLY);
+	if (dpd->regidx_fd < 0) {
+		fprintf(stderr, "condriver: unable to open %s for writing: %s\n",
+			dpd->regidx_fname, strerror(errno));
+		if (errno == ENOENT)
+			fprintf(stderr, "condriver: has driver %s been built without debugfs support?\n",
+				di->name);
+		goto err;
+	}
+	dpd->regval_fd = open(dpd->regval_fname, O_RDWR);
+	if (dpd->regval_fd < 0) {
+		fprintf(stderr, "condriver: unable to open %s: %s\n",
+			dpd->regval_fname, strerror(errno));
+		goto err;
+	}
+
+	if (di->debugfs.regdump_fname) {
+		dpd->regdump_fname = driver_path(dir, di->debugfs.regdump_fname);
+		if (dpd->regdump_fname && stat(dpd->regdump_fname, &statbuf)) {
+			free(dpd->regdump_fname);
+			dpd->regdump_fname = NULL;
+		}
+	}
+
+	if (di->debugfs.caldata_fname) {
+		dpd->caldata_fname = driver_path(dir, di->debugfs.caldata_fname);
+		if (dpd->caldata_fname && stat(dpd->caldata_fname, &statbuf)) {
+			free(dpd->caldata_fname);
+			dpd->caldata_fname = NULL;
+		}
+	}
+
+#if defined(CONFIG_CON_DRIVER_URING)
+	dpd->uring = driver_uring_init(aem);
+#endif
+
+	return 0;
+
+err:
+	driver_files_clean(aem);
+
+	return -1;
+}
+
+/**
+ * Use driver debug files directly from the <dir> directory. Driver type is
+ * detected by the register address file name.
+ */
+static int driver_init_dir(struct atheepmgr *aem, const char *dir)
+{
+	const struct driver_info *di;
+	struct stat statbuf;
+	char *path;
+	int i, res;
+
+	for (i = 0; i < ARRAY_SIZE(driver_infos); ++i) {
+		di = &driver_infos[i];
+		path = driver_path(dir, di->debugfs.regidx_fname);
+		if (!path)
+			return -1;
+		res = stat(path, &statbuf);
+		free(path);
+		if (res == 0)
+			return driver_files_init(aem, di, dir);
+	}
+
+	fprintf(stderr, "condriver: no known driver debug files in %s\n", dir);
+
+	return -1;
 }
 
 #define STATERRMSG(__path)						\
@@ -201,11 +708,13 @@ static void driver_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
 static int driver_init(struct atheepmgr *aem, const char *arg_str)
 {
 	char *p, pbuf[0x100], phyname[0x20], drivername[0x40];
-	struct driver_priv *dpd = aem->con_priv;
 	const struct driver_info *di;
 	struct stat statbuf;
 	int i, j, res;
 
+	if (strchr(arg_str, '/'))
+		return driver_init_dir(aem, arg_str);
+
 	TEST_DIR(DEBUGFS_PATH, "has the DebugFS been mounted?");
 	TEST_DIR(SYSFS_CFG80211_PATH, "has cfg80211 module been loaded?");
 	TEST_DIR(DEBUGFS_CFG80211_PATH,
@@ -288,44 +797,10 @@ skip_netdev:
 		return -1;
 	}
 
-	snprintf(pbuf, sizeof(pbuf), DEBUGFS_CFG80211_PATH"/%s/%s/%s",
-		 phyname, di->name, di->debugfs.regidx_fname);
-	if (stat(pbuf, &statbuf)) {
-		STATERRMSG(pbuf);
-		if (errno == ENOENT)
-			fprintf(stderr, "condriver: has driver %s been built without debugfs support?",
-				di->name);
-		goto err;
-	}
-	dpd->regidx_fname = strdup(pbuf);
-	if (!dpd->regidx_fname) {
-		fprintf(stderr, "condriver: unable to allocate memory for register address file path\n");
-		goto err;
-	}
-
-	snprintf(pbuf, sizeof(pbuf), DEBUGFS_CFG80211_PATH"/%s/%s/%s",
-		 phyname, di->name, di->debugfs.regval_fname);
-	if (stat(pbuf, &statbuf)) {
-		STATERRMSG(pbuf);
-		if (errno == ENOENT)
-			fprintf(stderr, "condriver: has driver %s been built without debugfs support?",
-				di->name);
-		goto err;
-	}
-	dpd->regval_fname = strdup(pbuf);
-	if (!dpd->regval_fname) {
-		fprintf(stderr, "condriver: unable to allocate memory for register value file path\n");
-		goto err;
-	}
+	snprintf(pbuf, sizeof(pbuf), DEBUGFS_CFG80211_PATH"/%s/%s",
+		 phyname, di->name);
 
-	dpd->regval_fmt = di->debugfs.regval_fmt;
-	dpd->regval_strlen = di->debugfs.regval_strlen;
-
-	return 0;
-
-err:
-	free(dpd->regidx_fname);
-	free(dpd->regval_fname);
+	return driver_files_init(aem, di, pbuf);
 
 err_dir:
 	return -1;
@@ -333,12 +808,14 @@ err_dir:
 
 static void driver_clean(struct atheepmgr *aem)
 {
-	struct driver_priv *dpd = aem->con_priv;
-
-	free(dpd->regidx_fname);
-	free(dpd->regval_fname);
+	driver_files_clean(aem);
 }
 
+static const struct blob_ops driver_blob = {
+	.getsize = driver_blob_getsize,
+	.read = driver_blob_read,
+};
+
 const struct connector con_driver = {
 	.name = "Driver",
 	.priv_data_sz = sizeof(struct driver_priv),
@@ -348,4 +825,6 @@ const struct connector con_driver = {
 	.reg_read = driver_reg_read,
 	.reg_write = driver_reg_write,
 	.reg_rmw = driver_reg_rmw,
+	.reg_bulk_read = driver_reg_bulk_read,
+	.blob = &driver_blob,
 };
@@ -15,6 +15,7 @@
  */
 
 #include "atheepmgr.h"
+#include "utils.h"
 
 struct file_priv {
 	FILE *fp;
@@ -22,19 +23,6 @@ struct file_priv {
 	uint32_t ic_sz;		/* IC size for addr wrap emulation */
 };
 
-/* See: https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2 */
-static uint32_t roundup_pow_of_2(uint32_t v)
-{
-	v--;
-	v |= v >> 1;
-	v |= v >> 2;
-	v |= v >> 4;
-	v |= v >> 8;
-	v |= v >> 16;
-
-	return v + 1;
-}
-
 static uint32_t file_reg_read(struct atheepmgr *aem, uint32_t reg)
 {
 	fprintf(stderr, "confile: direct reg access is not supported\n");
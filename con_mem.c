@@ -24,6 +24,7 @@
 struct mem_priv {
 	int devmem_fd;
 	off_t io_addr;
+	size_t io_size;
 	void *io_map;
 };
 
@@ -53,6 +54,22 @@ static void mem_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
 	*((volatile uint32_t *)(mpd->io_map + reg)) = tmp;
 }
 
+static int mem_reg_bulk_read(struct atheepmgr *aem, uint32_t reg,
+			     uint32_t *vals, unsigned int num)
+{
+	struct mem_priv *mpd = aem->con_priv;
+	volatile uint32_t *p = mpd->io_map + reg;
+	unsigned int i;
+
+	if (reg + (size_t)num * sizeof(uint32_t) > mpd->io_size)
+		return -ERANGE;
+
+	for (i = 0; i < num; ++i)
+		vals[i] = p[i];
+
+	return 0;
+}
+
 static int mem_init(struct atheepmgr *aem, const char *arg_str)
 {
 	struct mem_priv *mpd = aem->con_priv;
@@ -74,6 +91,7 @@ static int mem_init(struct atheepmgr *aem, const char *arg_str)
 		return -errno;
 	}
 
+	mpd->io_size = mem_size;
 	mpd->io_map = mmap(NULL, mem_size, PROT_READ | PROT_WRITE,
 			   MAP_SHARED | MAP_FILE, mpd->devmem_fd, mpd->io_addr);
 	if (MAP_FAILED == mpd->io_map) {
@@ -83,6 +101,7 @@ static int mem_init(struct atheepmgr *aem, const char *arg_str)
 		close(mpd->devmem_fd);
 		return -errno;
 	}
+	aem->io_map = mpd->io_map;
 
 	return 0;
 }
@@ -97,11 +116,12 @@ static void mem_clean(struct atheepmgr *aem)
 const struct connector con_mem = {
 	.name = "Mem",
 	.priv_data_sz = sizeof(struct mem_priv),
-	.caps = CON_CAP_HW,
+	.caps = CON_CAP_HW | CON_CAP_MMIO,
 	.init = mem_init,
 	.clean = mem_clean,
 	.reg_read = mem_reg_read,
 	.reg_write = mem_reg_write,
 	.reg_rmw = mem_reg_rmw,
+	.reg_bulk_read = mem_reg_bulk_read,
 };
 
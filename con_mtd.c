@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
+#if defined(__linux__)
+#include <mtd/mtd-user.h>
+#endif
+
+#include "atheepmgr.h"
+
+/**
+ * Flash region connector gives access to a calibration data window, which is
+ * located at some offset inside a flash partition (MTD char device) or inside
+ * a full flash image file. The window is fetched with a single positioned
+ * read on initialization and then all requests are served from memory.
+ *
+ * Writes are collected in memory and then flushed when the action succeeded,
+ * each modified erase block is read, patched, erased (for MTD devices) and
+ * written back as a whole exactly once. The last block of an image file could
+ * be shorter than the erase block.
+ */
+
+#define MTD_WINDOW_MAX		0x100000	/* 1 MB */
+#define MTD_FILE_ERASESIZE	0x10000		/* Erase block for images */
+
+struct mtd_priv {
+	int fd;
+	bool is_mtd;		/* Is it a real MTD device? */
+	uint32_t erasesize;
+	off_t size;		/* Device or image size */
+	off_t off;		/* Window offset */
+	uint32_t len;		/* Window length */
+	uint8_t *buf;		/* Window data */
+	uint8_t *dirty;		/* Modified erase blocks map (byte per block) */
+	uint32_t dirty_first;	/* Index of the first window erase block */
+	uint32_t dirty_num;
+};
+
+static uint32_t mtd_reg_read(struct atheepmgr *aem, uint32_t reg)
+{
+	fprintf(stderr, "conmtd: direct reg access is not supported\n");
+
+	return 0;
+}
+
+static void mtd_reg_write(struct atheepmgr *aem, uint32_t reg, uint32_t val)
+{
+	fprintf(stderr, "conmtd: direct reg write is not supported\n");
+}
+
+static void mtd_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
+			uint32_t clr)
+{
+	fprintf(stderr, "conmtd: direct reg RMW is not supported\n");
+}
+
+static int mtd_blob_getsize(struct atheepmgr *aem)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+
+	return mpd->len;
+}
+
+static int mtd_blob_read(struct atheepmgr *aem, void *buf, int len)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+
+	if (len > mpd->len)
+		len = mpd->len;
+	memcpy(buf, mpd->buf, len);
+
+	return len;
+}
+
+static bool mtd_eeprom_read(struct atheepmgr *aem, uint32_t off,
+			    uint16_t *data)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+	uint32_t pos = off * 2;
+
+	if (pos + sizeof(*data) > mpd->len) {	/* Emulate erased flash */
+		*data = 0xffff;
+		return true;
+	}
+
+	memcpy(data, mpd->buf + pos, sizeof(*data));
+
+	return true;
+}
+
+static bool mtd_eeprom_write(struct atheepmgr *aem, uint32_t off,
+			     uint16_t data)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+	uint32_t pos = off * 2;
+
+	if (pos + sizeof(data) > mpd->len) {
+		fprintf(stderr, "conmtd: write at 0x%04x is out of the window\n",
+			pos);
+		return false;
+	}
+
+	memcpy(mpd->buf + pos, &data, sizeof(data));
+	mpd->dirty[(mpd->off + pos) / mpd->erasesize - mpd->dirty_first] = 1;
+
+	return true;
+}
+
+static bool mtd_otp_read(struct atheepmgr *aem, uint32_t off, uint8_t *data)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+
+	if (off >= mpd->len) {		/* Emulate empty area */
+		*data = 0x00;
+		return true;
+	}
+
+	*data = mpd->buf[off];
+
+	return true;
+}
+
+static bool mtd_pread_all(int fd, void *buf, size_t len, off_t off)
+{
+	ssize_t res;
+
+	while (len) {
+		res = pread(fd, buf, len, off);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return false;
+		buf += res;
+		len -= res;
+		off += res;
+	}
+
+	return true;
+}
+
+static bool mtd_pwrite_all(int fd, const void *buf, size_t len, off_t off)
+{
+	ssize_t res;
+
+	while (len) {
+		res = pwrite(fd, buf, len, off);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res <= 0)
+			return false;
+		buf += res;
+		len -= res;
+		off += res;
+	}
+
+	return true;
+}
+
+static int mtd_flush_block(struct atheepmgr *aem, uint32_t blk, uint8_t *tmp)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+	off_t start = (off_t)blk * mpd->erasesize, wstart, wend;
+	size_t len = mpd->erasesize;
+
+	if (!mpd->is_mtd && start + len > mpd->size)
+		len = mpd->size - start;	/* Image tail */
+
+	if (!mtd_pread_all(mpd->fd, tmp, len, start))
+		return -EIO;
+
+	/* Patch the block with the window data */
+	wstart = mpd->off > start ? mpd->off : start;
+	wend = mpd->off + mpd->len < start + len ?
+	       mpd->off + mpd->len : start + len;
+	memcpy(tmp + (wstart - start), mpd->buf + (wstart - mpd->off),
+	       wend - wstart);
+
+#if defined(__linux__)
+	if (mpd->is_mtd) {
+		struct erase_info_user ei = {
+			.start = start,
+			.length = mpd->erasesize,
+		};
+
+		if (ioctl(mpd->fd, MEMERASE, &ei) != 0)
+			return -errno;
+	}
+#endif
+
+	if (!mtd_pwrite_all(mpd->fd, tmp, len, start))
+		return -EIO;
+
+	if (aem->verbose)
+		printf("conmtd: flushed erase block at 0x%08llx\n",
+		       (unsigned long long)start);
+
+	return 0;
+}
+
+static int mtd_parse_arg(struct mtd_priv *mpd, char *str, unsigned long *len)
+{
+	char *p, *endp;
+
+	mpd->off = 0;
+	*len = 0;
+
+	p = strchr(str, ':');
+	if (!p)
+		return 0;
+	*p++ = '\0';
+
+	errno = 0;
+	mpd->off = strtoul(p, &endp, 0);
+	if (errno || endp == p || (*endp != '\0' && *endp != ':'))
+		return -1;
+	if (*endp == '\0')
+		return 0;
+
+	p = endp + 1;
+	*len = strtoul(p, &endp, 0);
+	if (errno || endp == p || *endp != '\0' || !*len)
+		return -1;
+
+	return 0;
+}
+
+static int mtd_init(struct atheepmgr *aem, const char *arg_str)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+	unsigned long len, size;
+	struct stat st;
+	char *path;
+	int err;
+
+	memset(mpd, 0x00, sizeof(*mpd));
+	mpd->fd = -1;
+
+	path = strdup(arg_str);
+	if (!path) {
+		fprintf(stderr, "conmtd: unable to allocate memory for the path\n");
+		return -ENOMEM;
+	}
+	if (mtd_parse_arg(mpd, path, &len)) {
+		fprintf(stderr, "conmtd: invalid region specification -- %s\n",
+			arg_str);
+		err = EINVAL;
+		goto err;
+	}
+
+	mpd->fd = open(path, O_RDWR);
+	if (mpd->fd < 0)
+		mpd->fd = open(path, O_RDONLY);
+	if (mpd->fd < 0) {
+		fprintf(stderr, "conmtd: can not open '%s': %s\n", path,
+			strerror(errno));
+		err = errno;
+		goto err;
+	}
+
+	if (fstat(mpd->fd, &st) != 0) {
+		fprintf(stderr, "conmtd: can not stat '%s': %s\n", path,
+			strerror(errno));
+		err = errno;
+		goto err;
+	}
+	size = st.st_size;
+	mpd->erasesize = MTD_FILE_ERASESIZE;
+
+#if defined(__linux__)
+	if (S_ISCHR(st.st_mode)) {
+		struct mtd_info_user mi;
+
+		if (ioctl(mpd->fd, MEMGETINFO, &mi) != 0) {
+			fprintf(stderr, "conmtd: '%s' is not an MTD device: %s\n",
+				path, strerror(errno));
+			err = errno;
+			goto err;
+		}
+		mpd->is_mtd = true;
+		mpd->erasesize = mi.erasesize;
+		size = mi.size;
+	}
+#endif
+	mpd->size = size;
+
+	if (mpd->off >= size || (len && mpd->off + len > size)) {
+		fprintf(stderr, "conmtd: region is out of the '%s' bounds (0x%lx bytes)\n",
+			path, size);
+		err = EINVAL;
+		goto err;
+	}
+	if (!len)
+		len = size - mpd->off;
+	if (len > MTD_WINDOW_MAX)
+		len = MTD_WINDOW_MAX;
+	mpd->len = len & ~1;	/* Align to 16 bit */
+
+	mpd->dirty_first = mpd->off / mpd->erasesize;
+	mpd->dirty_num = (mpd->off + mpd->len + mpd->erasesize - 1) /
+			 mpd->erasesize - mpd->dirty_first;
+	mpd->buf = malloc(mpd->len);
+	mpd->dirty = calloc(mpd->dirty_num, 1);
+	if (!mpd->buf || !mpd->dirty) {
+		fprintf(stderr, "conmtd: unable to allocate memory for region data\n");
+		err = ENOMEM;
+		goto err;
+	}
+
+	if (!mtd_pread_all(mpd->fd, mpd->buf, mpd->len, mpd->off)) {
+		fprintf(stderr, "conmtd: unable to read region data: %s\n",
+			strerror(errno));
+		err = EIO;
+		goto err;
+	}
+
+	if (aem->verbose)
+		printf("conmtd: use 0x%04x bytes at 0x%08llx of %s %s (erase block 0x%x bytes)\n",
+		       mpd->len, (unsigned long long)mpd->off,
+		       mpd->is_mtd ? "MTD device" : "image", path,
+		       mpd->erasesize);
+
+	free(path);
+
+	return 0;
+
+err:
+	free(mpd->dirty);
+	free(mpd->buf);
+	if (mpd->fd >= 0)
+		close(mpd->fd);
+	free(path);
+
+	return -err;
+}
+
+static int mtd_flush(struct atheepmgr *aem)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+	uint8_t *tmp = NULL;
+	uint32_t i;
+	int ret = 0;
+
+	for (i = 0; i < mpd->dirty_num; ++i) {
+		if (!mpd->dirty[i])
+			continue;
+		if (!tmp)
+			tmp = malloc(mpd->erasesize);
+		ret = tmp ? mtd_flush_block(aem, mpd->dirty_first + i, tmp) :
+			    -ENOMEM;
+		if (ret) {
+			fprintf(stderr, "conmtd: unable to write erase block #%u\n",
+				mpd->dirty_first + i);
+			break;
+		}
+		mpd->dirty[i] = 0;
+	}
+
+	free(tmp);
+
+	return ret;
+}
+
+static void mtd_clean(struct atheepmgr *aem)
+{
+	struct mtd_priv *mpd = aem->con_priv;
+
+	free(mpd->dirty);
+	free(mpd->buf);
+	close(mpd->fd);
+}
+
+static const struct blob_ops blob_mtd = {
+	.getsize = mtd_blob_getsize,
+	.read = mtd_blob_read,
+};
+
+static const struct eep_ops eep_mtd = {
+	.read = mtd_eeprom_read,
+	.write = mtd_eeprom_write,
+};
+
+static const struct otp_ops otp_mtd = {
+	.read = mtd_otp_read,
+};
+
+const struct connector con_mtd = {
+	.name = "MTD",
+	.priv_data_sz = sizeof(struct mtd_priv),
+	.init = mtd_init,
+	.clean = mtd_clean,
+	.flush = mtd_flush,
+	.reg_read = mtd_reg_read,
+	.reg_write = mtd_reg_write,
+	.reg_rmw = mtd_reg_rmw,
+	.blob = &blob_mtd,
+	.eep = &eep_mtd,
+	.otp = &otp_mtd,
+};
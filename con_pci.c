@@ -100,6 +100,7 @@ static int pci_device_init(struct atheepmgr *aem, struct pci_device *pdev)
 		fprintf(stderr, "Unable to map mem range: %s (%d)\n", strerror(err), err);
 		return err;
 	}
+	aem->io_map = ppd->io_map;
 
 	if (aem->verbose)
 		printf("Mapped IO region at: %p\n", ppd->io_map);
@@ -146,6 +147,22 @@ static void pci_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
 	*((volatile uint32_t *)(ppd->io_map + reg)) = tmp;
 }
 
+static int pci_reg_bulk_read(struct atheepmgr *aem, uint32_t reg,
+			     uint32_t *vals, unsigned int num)
+{
+	struct pci_priv *ppd = aem->con_priv;
+	volatile uint32_t *p = ppd->io_map + reg;
+	unsigned int i;
+
+	if (reg + (pciaddr_t)num * sizeof(uint32_t) > ppd->size)
+		return -ERANGE;
+
+	for (i = 0; i < num; ++i)
+		vals[i] = p[i];
+
+	return 0;
+}
+
 static int pci_parse_devarg(const char *str, struct pci_slot_match *slot)
 {
 	int num, len;
@@ -251,10 +268,11 @@ static void pci_clean(struct atheepmgr *aem)
 const struct connector con_pci = {
 	.name = "PCI",
 	.priv_data_sz = sizeof(struct pci_priv),
-	.caps = CON_CAP_HW | CON_CAP_PNP,
+	.caps = CON_CAP_HW | CON_CAP_PNP | CON_CAP_MMIO,
 	.init = pci_init,
 	.clean = pci_clean,
 	.reg_read = pci_reg_read,
 	.reg_write = pci_reg_write,
 	.reg_rmw = pci_reg_rmw,
+	.reg_bulk_read = pci_reg_bulk_read,
 };
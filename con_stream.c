@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "atheepmgr.h"
+#include "utils.h"
+
+/**
+ * Stream connector reads the whole dump from a file descriptor (e.g. stdin)
+ * at once and then serves all requests from memory, so dumps could be passed
+ * via pipes without staging them to disk. Optionally the image, possibly
+ * modified by an update, is written to an output descriptor if the action
+ * succeeded.
+ *
+ * EEPROM address wrap and empty area are emulated like for the file
+ * connector.
+ */
+
+#define STREAM_DATA_MAX		0x10000		/* 64 KB */
+
+struct stream_priv {
+	int in_fd;
+	int out_fd;		/* Output descriptor, -1 if not used */
+	uint8_t *buf;		/* STREAM_DATA_MAX bytes */
+	uint32_t data_len;	/* Stream data length */
+	uint32_t ic_sz;		/* IC size for addr wrap emulation */
+};
+
+static uint32_t stream_reg_read(struct atheepmgr *aem, uint32_t reg)
+{
+	fprintf(stderr, "constream: direct reg access is not supported\n");
+
+	return 0;
+}
+
+static void stream_reg_write(struct atheepmgr *aem, uint32_t reg,
+			     uint32_t val)
+{
+	fprintf(stderr, "constream: direct reg write is not supported\n");
+}
+
+static void stream_reg_rmw(struct atheepmgr *aem, uint32_t reg, uint32_t set,
+			   uint32_t clr)
+{
+	fprintf(stderr, "constream: direct reg RMW is not supported\n");
+}
+
+static int stream_blob_getsize(struct atheepmgr *aem)
+{
+	struct stream_priv *spd = aem->con_priv;
+
+	return spd->data_len;
+}
+
+static int stream_blob_read(struct atheepmgr *aem, void *buf, int len)
+{
+	struct stream_priv *spd = aem->con_priv;
+
+	if (len > spd->data_len)
+		len = spd->data_len;
+	memcpy(buf, spd->buf, len);
+
+	return len;
+}
+
+static bool stream_eeprom_read(struct atheepmgr *aem, uint32_t off,
+			       uint16_t *data)
+{
+	struct stream_priv *spd = aem->con_priv;
+	uint32_t pos = off * 2;
+
+	pos = pos % spd->ic_sz;		/* Emulate address wrap */
+
+	if (pos >= spd->data_len) {	/* Emulate empty area */
+		*data = 0xffff;
+		return true;
+	}
+
+	memcpy(data, spd->buf + pos, sizeof(*data));
+
+	return true;
+}
+
+static bool stream_eeprom_write(struct atheepmgr *aem, uint32_t off,
+				uint16_t data)
+{
+	struct stream_priv *spd = aem->con_priv;
+	uint32_t pos = off * 2;
+
+	pos = pos % spd->ic_sz;		/* Emulate address wrap */
+
+	if (pos + sizeof(data) > STREAM_DATA_MAX)
+		return false;
+
+	if (pos >= spd->data_len) {
+		/* Fill the empty area before writing position */
+		memset(spd->buf + spd->data_len, 0xff, pos - spd->data_len);
+		spd->data_len = pos + sizeof(data);	/* NB: with new data */
+	}
+
+	memcpy(spd->buf + pos, &data, sizeof(data));
+
+	return true;
+}
+
+static bool stream_otp_read(struct atheepmgr *aem, uint32_t off,
+			    uint8_t *data)
+{
+	struct stream_priv *spd = aem->con_priv;
+
+	if (off >= spd->data_len) {	/* Emulate empty area */
+		*data = 0x00;
+		return true;
+	}
+
+	*data = spd->buf[off];
+
+	return true;
+}
+
+static int stream_parse_fd(const char *str, int *fd)
+{
+	unsigned long val;
+	char *endp;
+
+	if (strcmp(str, "-") == 0) {
+		*fd = STDIN_FILENO;
+		return 0;
+	}
+
+	errno = 0;
+	val = strtoul(str, &endp, 10);
+	if (errno || endp == str || (*endp != '\0' && *endp != ':') ||
+	    val > INT32_MAX)
+		return -1;
+	*fd = val;
+
+	return 0;
+}
+
+static int stream_init(struct atheepmgr *aem, const char *arg_str)
+{
+	struct stream_priv *spd = aem->con_priv;
+	const char *p;
+	ssize_t res;
+	uint8_t c;
+
+	spd->out_fd = -1;
+	spd->data_len = 0;
+
+	p = strchr(arg_str, ':');
+	if (stream_parse_fd(arg_str, &spd->in_fd) != 0 ||
+	    (p && stream_parse_fd(p + 1, &spd->out_fd) != 0)) {
+		fprintf(stderr, "constream: invalid descriptors specification -- %s\n",
+			arg_str);
+		return -EINVAL;
+	}
+
+	spd->buf = malloc(STREAM_DATA_MAX);
+	if (!spd->buf) {
+		fprintf(stderr, "constream: unable to allocate memory for data\n");
+		return -ENOMEM;
+	}
+
+	while (spd->data_len < STREAM_DATA_MAX) {
+		res = read(spd->in_fd, spd->buf + spd->data_len,
+			   STREAM_DATA_MAX - spd->data_len);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res < 0) {
+			fprintf(stderr, "constream: unable to read data: %s\n",
+				strerror(errno));
+			free(spd->buf);
+			return -EIO;
+		}
+		if (res == 0)
+			break;
+		spd->data_len += res;
+	}
+
+	if (spd->data_len == STREAM_DATA_MAX) {
+		do {
+			res = read(spd->in_fd, &c, sizeof(c));
+		} while (res < 0 && errno == EINTR);
+		if (res != 0) {
+			fprintf(stderr, "constream: input is longer than %u bytes\n",
+				STREAM_DATA_MAX);
+			free(spd->buf);
+			return -EFBIG;
+		}
+	}
+
+	spd->data_len &= ~1;	/* Align to 16 bit */
+	spd->ic_sz = roundup_pow_of_2(spd->data_len);
+	if (spd->ic_sz < 0x0800)	/* Do not emulate too small IC */
+		spd->ic_sz = 0x0800;
+
+	if (aem->verbose)
+		printf("constream: data length is 0x%04x (%u) bytes, emulate 0x%04x bytes (%u KB, %u kbit) EEPROM IC\n",
+		       spd->data_len, spd->data_len, spd->ic_sz,
+		       spd->ic_sz / 1024, spd->ic_sz * 8 / 1024);
+
+	return 0;
+}
+
+static int stream_flush(struct atheepmgr *aem)
+{
+	struct stream_priv *spd = aem->con_priv;
+	uint32_t pos = 0;
+	ssize_t res;
+
+	while (spd->out_fd >= 0 && pos < spd->data_len) {
+		res = write(spd->out_fd, spd->buf + pos, spd->data_len - pos);
+		if (res < 0 && errno == EINTR)
+			continue;
+		if (res < 0) {
+			fprintf(stderr, "constream: unable to write data: %s\n",
+				strerror(errno));
+			return -EIO;
+		}
+		pos += res;
+	}
+
+	return 0;
+}
+
+static void stream_clean(struct atheepmgr *aem)
+{
+	struct stream_priv *spd = aem->con_priv;
+
+	free(spd->buf);
+}
+
+static const struct blob_ops blob_stream = {
+	.getsize = stream_blob_getsize,
+	.read = stream_blob_read,
+};
+
+static const struct eep_ops eep_stream = {
+	.read = stream_eeprom_read,
+	.write = stream_eeprom_write,
+};
+
+static const struct otp_ops otp_stream = {
+	.read = stream_otp_read,
+};
+
+const struct connector con_stream = {
+	.name = "Stream",
+	.priv_data_sz = sizeof(struct stream_priv),
+	.init = stream_init,
+	.clean = stream_clean,
+	.flush = stream_flush,
+	.reg_read = stream_reg_read,
+	.reg_write = stream_reg_write,
+	.reg_rmw = stream_reg_rmw,
+	.blob = &blob_stream,
+	.eep = &eep_stream,
+	.otp = &otp_stream,
+};
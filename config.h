@@ -0,0 +1,6 @@
+/* Automatically generated. DO NOT EDIT. */
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+#define CONFIG_CON_DRIVER
+#define CONFIG_CON_MEM
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "atheepmgr.h"
+#include "eep_common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSUM_X86
+#endif
+
+/**
+ * There are two checksum kinds: the XOR of 16-bits words, which is used by
+ * the most EEPROM maps, and the 16-bits sum of octets, which is used to check
+ * AR93xx compressed blocks. Both of them are trivially vectorizable since the
+ * XOR is lanes independent, while the sum is taken by modulo 2^16, so lanes
+ * could be summed in any order.
+ *
+ * Each implementation should produce results that are identical to the
+ * scalar one. The best supported implementation is selected on a first call.
+ */
+
+static uint16_t csum_xor16_scalar(const uint16_t *buf, size_t len)
+{
+	uint16_t csum = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		csum ^= *buf++;
+
+	return csum;
+}
+
+static uint16_t csum_sum8_scalar(const uint8_t *data, int dsize)
+{
+	int it, checksum = 0;
+
+	for (it = 0; it < dsize; it++) {
+		checksum += data[it];
+		checksum &= 0xffff;
+	}
+
+	return checksum;
+}
+
+static uint16_t csum_xor16_swar(const uint16_t *buf, size_t len)
+{
+	uint64_t acc = 0, w;
+	size_t i = 0;
+
+	for (; i + 4 <= len; i += 4) {
+		memcpy(&w, &buf[i], sizeof(w));
+		acc ^= w;
+	}
+	acc ^= acc >> 32;
+	acc ^= acc >> 16;
+
+	return (uint16_t)acc ^ csum_xor16_scalar(&buf[i], len - i);
+}
+
+static uint16_t csum_sum8_swar(const uint8_t *data, int dsize)
+{
+	const uint64_t m = 0x00ff00ff00ff00ffULL;
+	uint64_t acc, w;
+	uint32_t sum = 0;
+	int i = 0, n;
+
+	while (i + 8 <= dsize) {
+		/**
+		 * Each 16-bits lane accumulates two octets per word, so flush
+		 * lanes before they are able to overflow.
+		 */
+		acc = 0;
+		for (n = 0; n < 128 && i + 8 <= dsize; ++n, i += 8) {
+			memcpy(&w, &data[i], sizeof(w));
+			acc += (w & m) + ((w >> 8) & m);
+		}
+		acc = (acc & 0x0000ffff0000ffffULL) +
+		      ((acc >> 16) & 0x0000ffff0000ffffULL);
+		sum += (uint32_t)acc + (uint32_t)(acc >> 32);
+	}
+
+	return (sum + csum_sum8_scalar(&data[i], dsize - i)) & 0xffff;
+}
+
+#if defined(CSUM_X86)
+__attribute__ ((target("sse2")))
+static uint16_t csum_xor16_sse2(const uint16_t *buf, size_t len)
+{
+	__m128i acc = _mm_setzero_si128();
+	uint16_t res[8];
+	size_t i = 0;
+	int j;
+
+	for (; i + 8 <= len; i += 8)
+		acc = _mm_xor_si128(acc,
+				    _mm_loadu_si128((const __m128i *)&buf[i]));
+	_mm_storeu_si128((__m128i *)res, acc);
+	for (j = 1; j < 8; ++j)
+		res[0] ^= res[j];
+
+	return res[0] ^ csum_xor16_scalar(&buf[i], len - i);
+}
+
+__attribute__ ((target("sse2")))
+static uint16_t csum_sum8_sse2(const uint8_t *data, int dsize)
+{
+	__m128i acc = _mm_setzero_si128(), zero = _mm_setzero_si128();
+	uint64_t res[2];
+	int i = 0;
+
+	/* SAD with zero sums 8 octets into each of 64-bits lanes */
+	for (; i + 16 <= dsize; i += 16)
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(zero,
+				    _mm_loadu_si128((const __m128i *)&data[i])));
+	_mm_storeu_si128((__m128i *)res, acc);
+
+	return (res[0] + res[1] + csum_sum8_scalar(&data[i], dsize - i)) &
+	       0xffff;
+}
+
+__attribute__ ((target("avx2")))
+static uint16_t csum_xor16_avx2(const uint16_t *buf, size_t len)
+{
+	__m256i acc = _mm256_setzero_si256();
+	uint16_t res[16];
+	size_t i = 0;
+	int j;
+
+	for (; i + 16 <= len; i += 16)
+		acc = _mm256_xor_si256(acc,
+				_mm256_loadu_si256((const __m256i *)&buf[i]));
+	_mm256_storeu_si256((__m256i *)res, acc);
+	for (j = 1; j < 16; ++j)
+		res[0] ^= res[j];
+
+	return res[0] ^ csum_xor16_scalar(&buf[i], len - i);
+}
+
+__attribute__ ((target("avx2")))
+static uint16_t csum_sum8_avx2(const uint8_t *data, int dsize)
+{
+	__m256i acc = _mm256_setzero_si256(), zero = _mm256_setzero_si256();
+	uint64_t res[4];
+	int i = 0;
+
+	for (; i + 32 <= dsize; i += 32)
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(zero,
+				_mm256_loadu_si256((const __m256i *)&data[i])));
+	_mm256_storeu_si256((__m256i *)res, acc);
+
+	return (res[0] + res[1] + res[2] + res[3] +
+		csum_sum8_scalar(&data[i], dsize - i)) & 0xffff;
+}
+
+static bool csum_sse2_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool csum_avx2_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+/* Ordered from the most preferred to the least one */
+const struct csum_impl csum_impls[] = {
+#if defined(CSUM_X86)
+	{ "avx2", csum_xor16_avx2, csum_sum8_avx2, csum_avx2_supported },
+	{ "sse2", csum_xor16_sse2, csum_sum8_sse2, csum_sse2_supported },
+#endif
+	{ "swar", csum_xor16_swar, csum_sum8_swar, NULL },
+	{ "scalar", csum_xor16_scalar, csum_sum8_scalar, NULL },
+	{ NULL }
+};
+
+static const struct csum_impl *csum_impl;
+
+/**
+ * Could be called concurrently (e.g. by scan threads), so the selected
+ * implementation is cached atomically. Concurrent first callers select the
+ * same implementation, so the race on the store is benign.
+ */
+const struct csum_impl *csum_impl_select(void)
+{
+	const struct csum_impl *impl;
+
+	impl = __atomic_load_n(&csum_impl, __ATOMIC_ACQUIRE);
+	if (impl)
+		return impl;
+
+	for (impl = csum_impls; impl->name; ++impl)
+		if (!impl->supported || impl->supported())
+			break;
+	__atomic_store_n(&csum_impl, impl, __ATOMIC_RELEASE);
+
+	return impl;
+}
+
+uint16_t eep_calc_csum(const uint16_t *buf, size_t len)
+{
+	return csum_impl_select()->xor16(buf, len);
+}
+
+uint16_t ar9300_comp_cksum(const uint8_t *data, int dsize)
+{
+	return csum_impl_select()->sum8(data, dsize);
+}
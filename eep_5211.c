@@ -922,34 +922,38 @@ static void eep_5211_fill_ctl_data_33(struct atheepmgr *aem)
 	}
 }
 
-static bool eep_5211_load_eeprom(struct atheepmgr *aem, bool raw)
+/* Parse data from the intermediate buffer */
+static void eep_5211_buf2eep(struct atheepmgr *aem)
 {
 	struct eep_5211_priv *emp = aem->eepmap_priv;
 	struct ar5211_eeprom *eep = &emp->eep;
 	struct ar5211_base_eep_hdr *base = &eep->base;
-	uint16_t endloc_up, endloc_lo;
-	uint16_t magic;
-	int len = 0, addr;
-	uint16_t *buf = aem->eep_buf;
 
-	if (raw) {	/* Use max size for RAW loading */
-		len = aem->eepmap->eep_buf_sz;
-		goto data_read;
-	}
+	memset(&emp->param, 0x00, sizeof(emp->param));
 
-	/* RAW magic reading with subsequent swaping requirement check */
-	if (!EEP_READ(AR5211_EEP_MAGIC, &magic)) {
-		fprintf(stderr, "EEPROM magic read failed\n");
-		return false;
-	}
-	if (bswap_16(magic) == htole16(AR5211_EEPROM_MAGIC_VAL))
-		aem->eep_io_swap = !aem->eep_io_swap;
+	eep_5211_fill_init_data(aem);
 
-	if (!EEP_READ(AR5211_EEP_ENDLOC_UP, &endloc_up) ||
-	    !EEP_READ(AR5211_EEP_ENDLOC_LO, &endloc_lo)) {
-		fprintf(stderr, "Unable to read EEPROM size\n");
-		return false;
+	eep_5211_fill_headers(aem);
+
+	eep_5211_parse_pdcal(aem);
+	eep_5211_parse_tgtpwr(aem);
+
+	if (base->version >= AR5211_EEP_VER_3_3) {
+		emp->param.ctls_num = AR5211_NUM_CTLS_33;
+		eep_5211_fill_ctl_index(aem, AR5211_EEP_CTL_INDEX_33);
+		eep_5211_fill_ctl_data_33(aem);
+	} else if (base->version >= AR5211_EEP_VER_3_0) {
+		emp->param.ctls_num = AR5211_NUM_CTLS_30;
+		eep_5211_fill_ctl_index(aem, AR5211_EEP_CTL_INDEX_30);
+		eep_5211_fill_ctl_data_30(aem);
 	}
+}
+
+/* Get data length from the end location words */
+static int eep_5211_data_len(struct atheepmgr *aem, uint16_t endloc_up,
+			     uint16_t endloc_lo)
+{
+	int len = 0;
 
 	if (endloc_up) {
 		endloc_up = le16toh(endloc_up);
@@ -970,6 +974,37 @@ static bool eep_5211_load_eeprom(struct atheepmgr *aem, bool raw)
 		len = AR5211_SIZE_DEF;
 	}
 
+	return len;
+}
+
+static bool eep_5211_load_eeprom(struct atheepmgr *aem, bool raw)
+{
+	uint16_t endloc_up, endloc_lo;
+	uint16_t magic;
+	int len = 0, addr;
+	uint16_t *buf = aem->eep_buf;
+
+	if (raw) {	/* Use actual IC size for RAW loading */
+		len = hw_eeprom_probe_size(aem, aem->eepmap->eep_buf_sz);
+		goto data_read;
+	}
+
+	/* RAW magic reading with subsequent swaping requirement check */
+	if (!EEP_READ(AR5211_EEP_MAGIC, &magic)) {
+		fprintf(stderr, "EEPROM magic read failed\n");
+		return false;
+	}
+	if (bswap_16(magic) == htole16(AR5211_EEPROM_MAGIC_VAL))
+		aem->eep_io_swap = !aem->eep_io_swap;
+
+	if (!EEP_READ(AR5211_EEP_ENDLOC_UP, &endloc_up) ||
+	    !EEP_READ(AR5211_EEP_ENDLOC_LO, &endloc_lo)) {
+		fprintf(stderr, "Unable to read EEPROM size\n");
+		return false;
+	}
+
+	len = eep_5211_data_len(aem, endloc_up, endloc_lo);
+
 data_read:
 	/* Read to intermediated buffer */
 	for (addr = 0; addr < len; ++addr, ++buf) {
@@ -984,25 +1019,41 @@ data_read:
 	if (raw)	/* Earlier exit on RAW contents loading */
 		return true;
 
-	memset(&emp->param, 0x00, sizeof(emp->param));
+	eep_5211_buf2eep(aem);
 
-	eep_5211_fill_init_data(aem);
+	return true;
+}
 
-	eep_5211_fill_headers(aem);
+static bool eep_5211_load_blob(struct atheepmgr *aem)
+{
+	uint16_t *buf = aem->eep_buf;
+	int len, i;
 
-	eep_5211_parse_pdcal(aem);
-	eep_5211_parse_tgtpwr(aem);
+	len = aem->con->blob->getsize(aem) / 2;
+	if (len > aem->eepmap->eep_buf_sz)
+		len = aem->eepmap->eep_buf_sz;
+	if (len <= AR5211_EEP_MAGIC)
+		return false;
+	if (!eep_blob2buf(aem, len))
+		return false;
 
-	if (base->version >= AR5211_EEP_VER_3_3) {
-		emp->param.ctls_num = AR5211_NUM_CTLS_33;
-		eep_5211_fill_ctl_index(aem, AR5211_EEP_CTL_INDEX_33);
-		eep_5211_fill_ctl_data_33(aem);
-	} else if (base->version >= AR5211_EEP_VER_3_0) {
-		emp->param.ctls_num = AR5211_NUM_CTLS_30;
-		eep_5211_fill_ctl_index(aem, AR5211_EEP_CTL_INDEX_30);
-		eep_5211_fill_ctl_data_30(aem);
+	/* Swapping requirement check, same as for the EEPROM loading */
+	if (bswap_16(buf[AR5211_EEP_MAGIC]) == htole16(AR5211_EEPROM_MAGIC_VAL)) {
+		aem->eep_io_swap = !aem->eep_io_swap;
+		for (i = 0; i < len; ++i)
+			buf[i] = bswap_16(buf[i]);
+	} else if (buf[AR5211_EEP_MAGIC] != htole16(AR5211_EEPROM_MAGIC_VAL)) {
+		return false;	/* Let EEPROM ops try */
 	}
 
+	len = eep_5211_data_len(aem, buf[AR5211_EEP_ENDLOC_UP],
+				buf[AR5211_EEP_ENDLOC_LO]);
+	if (len > aem->eep_len)
+		return false;	/* Blob is truncated, let EEPROM ops try */
+	aem->eep_len = len;
+
+	eep_5211_buf2eep(aem);
+
 	return true;
 }
 
@@ -1557,6 +1608,7 @@ const struct eepmap eepmap_5211 = {
 	},
 	.priv_data_sz = sizeof(struct eep_5211_priv),
 	.eep_buf_sz = AR5211_SIZE_MAX,
+	.load_blob = eep_5211_load_blob,
 	.load_eeprom = eep_5211_load_eeprom,
 	.check_eeprom = eep_5211_check,
 	.dump = {
@@ -38,11 +38,24 @@ static int eep_9287_get_rev(struct eep_9287_priv *emp)
 	return (emp->eep.baseEepHeader.version) & 0xFFF;
 }
 
-static bool eep_9287_load_eeprom(struct atheepmgr *aem, bool raw)
+/* Copy data from the intermediate buffer to the Init data and the EEPROM */
+static void eep_9287_buf2eep(struct atheepmgr *aem)
 {
 	struct eep_9287_priv *emp = aem->eepmap_priv;
 	uint16_t *eep_data = (uint16_t *)&emp->eep;
 	uint16_t *eep_init = (uint16_t *)&emp->ini;
+	const uint16_t *buf = aem->eep_buf;
+	int addr;
+
+	for (addr = 0; addr < AR9287_DATA_START_LOC; ++addr)
+		eep_init[addr] = buf[addr];
+
+	for (addr = 0; addr < AR9287_DATA_SZ; ++addr)
+		eep_data[addr] = buf[AR9287_DATA_START_LOC + addr];
+}
+
+static bool eep_9287_load_eeprom(struct atheepmgr *aem, bool raw)
+{
 	uint16_t *buf = aem->eep_buf;
 	int addr;
 
@@ -62,13 +75,26 @@ static bool eep_9287_load_eeprom(struct atheepmgr *aem, bool raw)
 	if (raw)	/* Earlier exit on RAW contents loading */
 		return true;
 
-	/* Copy from buffer to the Init data */
-	for (addr = 0; addr < AR9287_DATA_START_LOC; ++addr)
-		eep_init[addr] = buf[addr];
+	eep_9287_buf2eep(aem);
 
-	/* Copy from buffer to the EEPROM structure */
-	for (addr = 0; addr < AR9287_DATA_SZ; ++addr)
-		eep_data[addr] = buf[AR9287_DATA_START_LOC + addr];
+	return true;
+}
+
+static bool eep_9287_load_blob(struct atheepmgr *aem)
+{
+	uint16_t magic;
+
+	if (!eep_blob2buf(aem, AR9287_DATA_START_LOC + AR9287_DATA_SZ))
+		return false;
+
+	magic = aem->eep_buf[AR5416_EEPROM_MAGIC_OFFSET];
+	if (magic != AR5416_EEPROM_MAGIC &&
+	    bswap_16(magic) != AR5416_EEPROM_MAGIC)
+		return false;	/* Let EEPROM ops try */
+
+	AR5416_TOGGLE_BYTESWAP_BUF(9287);
+
+	eep_9287_buf2eep(aem);
 
 	return true;
 }
@@ -472,6 +498,7 @@ const struct eepmap eepmap_9287 = {
 	},
 	.priv_data_sz = sizeof(struct eep_9287_priv),
 	.eep_buf_sz = AR9287_DATA_START_LOC + AR9287_DATA_SZ,
+	.load_blob    = eep_9287_load_blob,
 	.load_eeprom  = eep_9287_load_eeprom,
 	.check_eeprom = eep_9287_check_eeprom,
 	.dump = {
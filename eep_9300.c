@@ -49,15 +49,20 @@ static const struct eeptemplate eep_9300_templates[] = {
 	{ 0, NULL }
 };
 
-static const uint8_t *ar9300_template_find_by_id(int id)
+static const uint8_t *ar9300_template_find_by_id(struct atheepmgr *aem, int id)
 {
 	const struct eeptemplate *tpl;
 
 	for (tpl = eep_9300_templates; tpl->name; ++tpl)
 		if (tpl->id == id)
-			break;
+			return tpl->data;
+
+	/* Not a builtin one, try the external templates pack */
+	tpl = tplpack_lookup(aem, aem->eepmap, id, NULL);
+	if (tpl && aem->verbose)
+		printf("use external template %d (%s)\n", tpl->id, tpl->name);
 
-	return tpl->data;
+	return tpl ? tpl->data : NULL;
 }
 
 /**
@@ -144,12 +149,6 @@ static int ar9300_otp2buf(struct atheepmgr *aem, int bytes)
 	return 0;
 }
 
-static bool ar9300_check_header(void *data)
-{
-	uint32_t *word = data;
-	return !(*word == 0 || *word == ~0);
-}
-
 static int ar9300_check_block_len(struct atheepmgr *aem, int max_len,
 				  int blk_len)
 {
@@ -201,13 +200,10 @@ static int ar9300_process_blocks(struct atheepmgr *aem, int cptr)
 			break;
 
 		ar9300_comp_hdr_unpack(buf, &hdr);
-		if (aem->verbose)
-			printf("Found block at %x: comp=%d ref=%d length=%d major=%d minor=%d\n",
-			       cptr, hdr.comp, hdr.ref, hdr.len, hdr.maj,
-			       hdr.min);
+		TRACE(9300_BLOCK, cptr, hdr.comp, hdr.ref,
+		      hdr.len | hdr.maj << 12 | hdr.min << 16);
 		if (!ar9300_check_block_len(aem, cptr, hdr.len)) {
-			if (aem->verbose)
-				printf("Skipping bad header\n");
+			TRACE(9300_BAD_LEN, cptr, hdr.len);
 			cptr -= AR9300_COMP_HDR_LEN;
 			continue;
 		}
@@ -220,9 +216,7 @@ static int ar9300_process_blocks(struct atheepmgr *aem, int cptr)
 		ptr = buf + AR9300_COMP_HDR_LEN + hdr.len;
 		mchecksum = ptr[0] | (ptr[1] << 8);
 		if (checksum != mchecksum) {
-			if (aem->verbose)
-				printf("Skipping block with bad checksum (got 0x%04x, expect 0x%04x)\n",
-				       checksum, mchecksum);
+			TRACE(9300_BAD_CSUM, cptr, checksum, mchecksum);
 			cptr -= AR9300_COMP_HDR_LEN;
 			continue;
 		}
@@ -245,6 +239,37 @@ static int ar9300_process_blocks(struct atheepmgr *aem, int cptr)
 #undef MSTATE
 }
 
+/**
+ * Look for the compressed data blocks at each of the candidate base
+ * addresses, fetch only required portion of data from the source. Base
+ * address, where data were found last time, is checked first. Returns found
+ * base address or -1.
+ */
+static int ar9300_find_blocks(struct atheepmgr *aem, int src, int *bases,
+			      int num, int (*fetch)(struct atheepmgr *, int))
+{
+	int i, tmp;
+
+	for (i = 1; i < num; ++i) {
+		if (bases[i] != aem->data_base_hint)
+			continue;
+		tmp = bases[0];
+		bases[0] = bases[i];
+		bases[i] = tmp;
+		break;
+	}
+
+	for (i = 0; i < num; ++i) {
+		TRACE(9300_ACCESS, src, bases[i]);
+		if (fetch(aem, bases[i]) != 0)
+			return -1;
+		if (ar9300_process_blocks(aem, bases[i]) == 0)
+			return aem->data_base = bases[i];
+	}
+
+	return -1;
+}
+
 static bool eep_9300_load_blob(struct atheepmgr *aem)
 {
 	const int data_size = sizeof(struct ar9300_eeprom);
@@ -277,12 +302,14 @@ static bool eep_9300_load_blob(struct atheepmgr *aem)
  */
 static bool eep_9300_load_raw_eeprom(struct atheepmgr *aem)
 {
-	const int eepsz = 0x1000;	/* Max EEPROM read length in words */
-	int i;
+	const int eepmax = 0x800;	/* Max EEPROM read length in words */
+	int i, eepsz;
 
-	if (aem->verbose)
-		printf("RAW EEPROM read [0x0000...0x%04x] words\n", eepsz - 1);
-	if (ar9300_eep2buf(aem, eepsz) != 0)
+	/* Read exactly one copy of a small wrapping EEPROM */
+	eepsz = hw_eeprom_probe_size(aem, eepmax);
+
+	TRACE(RAW_READ, TRACE_SRC_EEPROM, eepsz);
+	if (ar9300_eep2buf(aem, eepsz * 2) != 0)
 		return false;
 
 	/* Check for unsoldered EEPROM */
@@ -312,6 +339,7 @@ static bool eep_9300_load_raw_eeprom(struct atheepmgr *aem)
 static bool eep_9300_load_eeprom(struct atheepmgr *aem, bool raw)
 {
 	struct eep_9300_priv *emp = aem->eepmap_priv;
+	int bases[2], nbases = 0;
 	uint16_t magic;
 	int cptr;
 
@@ -327,39 +355,24 @@ static bool eep_9300_load_eeprom(struct atheepmgr *aem, bool raw)
 		return false;
 	}
 	if (bswap_16(magic) == AR5416_EEPROM_MAGIC) {
-		if (aem->verbose)
-			printf("Use byteswapped EEPROM I/O\n");
 		aem->eep_io_swap = !aem->eep_io_swap;
 	} else if (magic != AR5416_EEPROM_MAGIC) {
 		return false;
 	}
 
-	if (aem->verbose)
-		printf("EEPROM magic found\n");
+	TRACE(EEP_MAGIC, magic != AR5416_EEPROM_MAGIC);
 
 	if (AR_SREV_9485(aem))
-		cptr = AR9300_BASE_ADDR_4K;
-	else if (AR_SREV_9330(aem))
-		cptr = AR9300_BASE_ADDR_512;
-	else
-		cptr = AR9300_BASE_ADDR;
-
-	if (aem->verbose)
-		printf("Trying EEPROM access at Address 0x%04x\n", cptr);
-	if (ar9300_eep2buf(aem, cptr) != 0)
+		bases[nbases++] = AR9300_BASE_ADDR_4K;
+	else if (!AR_SREV_9330(aem))
+		bases[nbases++] = AR9300_BASE_ADDR;
+	bases[nbases++] = AR9300_BASE_ADDR_512;
+
+	cptr = ar9300_find_blocks(aem, TRACE_SRC_EEPROM, bases, nbases,
+				  ar9300_eep2buf);
+	if (cptr < 0)
 		return false;
-	if (ar9300_process_blocks(aem, cptr) == 0)
-		goto found;
 
-	cptr = AR9300_BASE_ADDR_512;
-	if (aem->verbose)
-		printf("Trying EEPROM access at Address 0x%04x\n", cptr);
-	if (ar9300_process_blocks(aem, cptr) == 0)
-		goto found;
-
-	return false;
-
-found:
 	emp->data_src = DATA_SRC_EEPROM;
 	aem->eep_len = (cptr + 1) / 2;	/* Set actual EEPROM size */
 	aem->unpacked_len = sizeof(struct ar9300_eeprom);
@@ -375,8 +388,7 @@ static bool eep_9300_load_raw_otp(struct atheepmgr *aem)
 {
 	const int otpsz = 0x400;	/* Max OTP read length in bytes */
 
-	if (aem->verbose)
-		printf("RAW OTP read [0x0000...0x%04x] bytes\n", otpsz - 1);
+	TRACE(RAW_READ, TRACE_SRC_OTP, otpsz);
 	if (ar9300_otp2buf(aem, otpsz) != 0)
 		return false;
 
@@ -393,6 +405,7 @@ static bool eep_9300_load_raw_otp(struct atheepmgr *aem)
 static bool eep_9300_load_otp(struct atheepmgr *aem, bool raw)
 {
 	struct eep_9300_priv *emp = aem->eepmap_priv;
+	int bases[] = {AR9300_BASE_ADDR, AR9300_BASE_ADDR_512};
 	int cptr;
 
 	emp->buf_is_be = aem->host_is_be;	/* OTP utilize native-endians */
@@ -401,23 +414,11 @@ static bool eep_9300_load_otp(struct atheepmgr *aem, bool raw)
 	if (raw)	/* RAW reading is a bit special case */
 		return eep_9300_load_raw_otp(aem);
 
-	cptr = AR9300_BASE_ADDR;
-	if (aem->verbose)
-		printf("Trying OTP access at Address 0x%04x\n", cptr);
-	if (ar9300_otp2buf(aem, cptr) != 0)
+	cptr = ar9300_find_blocks(aem, TRACE_SRC_OTP, bases,
+				  ARRAY_SIZE(bases), ar9300_otp2buf);
+	if (cptr < 0)
 		return false;
-	if (ar9300_process_blocks(aem, cptr) == 0)
-		goto found;
-
-	cptr = AR9300_BASE_ADDR_512;
-	if (aem->verbose)
-		printf("Trying OTP access at Address 0x%04x\n", cptr);
-	if (ar9300_process_blocks(aem, cptr) == 0)
-		goto found;
-
-	return false;
 
-found:
 	emp->data_src = DATA_SRC_OTP;
 	aem->eep_len = (cptr + 1) / 2;	/* Set actual EEPROM size */
 	aem->unpacked_len = sizeof(struct ar9300_eeprom);
@@ -37,15 +37,20 @@ static const struct eeptemplate eep_9880_templates[] = {
 	{ 0, NULL }
 };
 
-static const uint8_t *qca9880_template_find_by_id(int id)
+static const uint8_t *qca9880_template_find_by_id(struct atheepmgr *aem, int id)
 {
 	const struct eeptemplate *tpl;
 
 	for (tpl = eep_9880_templates; tpl->name; ++tpl)
 		if (tpl->id == id)
-			break;
+			return tpl->data;
+
+	/* Not a builtin one, try the external templates pack */
+	tpl = tplpack_lookup(aem, aem->eepmap, id, NULL);
+	if (tpl && aem->verbose)
+		printf("use external template %d (%s)\n", tpl->id, tpl->name);
 
-	return tpl->data;
+	return tpl ? tpl->data : NULL;
 }
 
 static void eep_9880_proc_otp_caldata(struct atheepmgr *aem,
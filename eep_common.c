@@ -61,23 +61,18 @@ const char * const eep_ctlmodes[] = {
 };
 
 /**
- * Detect possible EEPROM I/O byteswapping and toggle I/O byteswap compensation
- * if need it to consistently load EEPROM data.
- *
- * NB: all offsets are in 16-bits words
+ * Detect possible EEPROM I/O byteswapping using the magic, the eepMisc and the
+ * binBuildNumber words, which are read with the current I/O compensation.
+ * Returns true if the I/O byteswap compensation should be toggled.
  */
-bool __ar5416_toggle_byteswap(struct atheepmgr *aem, uint32_t eepmisc_off,
-			      uint32_t binbuildnum_off)
+static bool ar5416_detect_byteswap(struct atheepmgr *aem, uint16_t magic,
+				   uint16_t misc, uint16_t binbuildnum)
 {
 	uint16_t word;
 	int magic_is_be;
 
 	/* First check whether magic is Little-endian or not */
-	if (!EEP_READ(AR5416_EEPROM_MAGIC_OFFSET, &word)) {
-		printf("Toggle EEPROM I/O byteswap compensation\n");
-		return false;
-	}
-	magic_is_be = word != AR5416_EEPROM_MAGIC;	/* Constant is LE */
+	magic_is_be = magic != AR5416_EEPROM_MAGIC;	/* Constant is LE */
 
 	/**
 	 * Now read {opCapFlags,eepMisc} pair of fields that lay in the same
@@ -110,24 +105,19 @@ bool __ar5416_toggle_byteswap(struct atheepmgr *aem, uint32_t eepmisc_off,
 	 *
 	 *  And we will need some more heuristic to solve it (see below).
 	 */
-	if (!EEP_READ(eepmisc_off, &word)) {
-		fprintf(stderr, "EEPROM misc field read failed\n");
-		return false;
-	}
-
-	word &= 0x0101;	/* Clear all except 5GHz and BigEndian bits */
+	word = misc & 0x0101;	/* Clear all except 5GHz and BigEndian bits */
 	if (word == 0x0000) {/* Clearly not Big-endian EEPROM */
 		if (!magic_is_be)
-			goto skip_eeprom_io_swap;
+			return false;
 		if (aem->verbose > 1)
 			printf("Got byteswapped Little-endian EEPROM data\n");
-		goto toggle_eeprom_io_swap;
+		return true;
 	} else if (word == 0x0101) {/* Clearly Big-endian EEPROM */
 		if (magic_is_be)
-			goto skip_eeprom_io_swap;
+			return false;
 		if (aem->verbose > 1)
 			printf("Got byteswapped Big-endian EEPROM data\n");
-		goto toggle_eeprom_io_swap;
+		return true;
 	}
 
 	if (aem->verbose > 1)
@@ -157,37 +147,105 @@ bool __ar5416_toggle_byteswap(struct atheepmgr *aem, uint32_t eepmisc_off,
 	 * endian-agnostic way to detect the byteswapping.
 	 */
 
-	if (!EEP_READ(binbuildnum_off, &word)) {
-		fprintf(stderr, "Calibration software build read failed\n");
-		return false;
-	}
-
-	word = le16toh(word);	/* Just to make a byteorder predictable */
+	word = le16toh(binbuildnum);	/* Just to make a byteorder predictable */
 
 	/* First we check for byteswapped case */
 	if ((word & 0xff00) == 0 && (word & 0x00ff) != 0)
-		goto toggle_eeprom_io_swap;
+		return true;
 
 	/* Now check for non-byteswapped case */
 	if ((word & 0xff00) != 0 && (word & 0x00ff) == 0) {
 		if (aem->verbose > 1)
 			printf("Looks like there are no byteswapping\n");
-		goto skip_eeprom_io_swap;
+		return false;
 	}
 
 	/* We have some weird software version, giving up */
 	if (aem->verbose > 1)
 		printf("Unable to detect byteswap, giving up\n");
 
-	if (!magic_is_be)	/* Prefer the Little-endian format */
-		goto skip_eeprom_io_swap;
+	return magic_is_be;	/* Prefer the Little-endian format */
+}
+
+/**
+ * Detect possible EEPROM I/O byteswapping and toggle I/O byteswap compensation
+ * if need it to consistently load EEPROM data.
+ *
+ * NB: all offsets are in 16-bits words
+ */
+bool __ar5416_toggle_byteswap(struct atheepmgr *aem, uint32_t eepmisc_off,
+			      uint32_t binbuildnum_off)
+{
+	uint16_t magic, misc, binbuildnum;
+
+	if (!EEP_READ(AR5416_EEPROM_MAGIC_OFFSET, &magic)) {
+		fprintf(stderr, "EEPROM magic read failed\n");
+		return false;
+	}
+	if (!EEP_READ(eepmisc_off, &misc)) {
+		fprintf(stderr, "EEPROM misc field read failed\n");
+		return false;
+	}
+	if (!EEP_READ(binbuildnum_off, &binbuildnum)) {
+		fprintf(stderr, "Calibration software build read failed\n");
+		return false;
+	}
+
+	if (ar5416_detect_byteswap(aem, magic, misc, binbuildnum)) {
+		if (aem->verbose)
+			printf("Toggle EEPROM I/O byteswap compensation\n");
+		aem->eep_io_swap = !aem->eep_io_swap;
+	}
+
+	return true;
+}
+
+/**
+ * Same as above, but for data that were loaded to the intermediate buffer
+ * (see eep_blob2buf()), buffer words are swapped in place if need it.
+ */
+void __ar5416_toggle_byteswap_buf(struct atheepmgr *aem, uint32_t eepmisc_off,
+				  uint32_t binbuildnum_off)
+{
+	uint16_t *buf = aem->eep_buf;
+	int i;
+
+	if (!ar5416_detect_byteswap(aem, buf[AR5416_EEPROM_MAGIC_OFFSET],
+				    buf[eepmisc_off], buf[binbuildnum_off]))
+		return;
 
-toggle_eeprom_io_swap:
 	if (aem->verbose)
 		printf("Toggle EEPROM I/O byteswap compensation\n");
 	aem->eep_io_swap = !aem->eep_io_swap;
 
-skip_eeprom_io_swap:
+	for (i = 0; i < aem->eep_len; ++i)
+		buf[i] = bswap_16(buf[i]);
+}
+
+/**
+ * Read <len> words of the data blob to the intermediate buffer with a single
+ * read. Words are compensated in memory as they would be by the EEPROM I/O,
+ * so the byteswap detection and the parsing are the same for both sources.
+ */
+bool eep_blob2buf(struct atheepmgr *aem, int len)
+{
+	uint16_t *buf = aem->eep_buf;
+	int i, res;
+
+	if (aem->con->blob->getsize(aem) < len * 2)
+		return false;
+	res = aem->con->blob->read(aem, buf, len * 2);
+	if (res != len * 2) {
+		fprintf(stderr, "Unable to read EEPROM blob\n");
+		return false;
+	}
+
+	if (aem->eep_io_swap)
+		for (i = 0; i < len; ++i)
+			buf[i] = bswap_16(buf[i]);
+
+	aem->eep_len = len;
+
 	return true;
 }
 
@@ -467,6 +525,12 @@ void ar5416_dump_ctl(const uint8_t *index,
 	}
 }
 
+bool ar9300_check_header(const void *data)
+{
+	const uint32_t *word = data;
+	return !(*word == 0 || *word == ~0);
+}
+
 void ar9300_comp_hdr_unpack(const uint8_t *p, struct ar9300_comp_hdr *hdr)
 {
 	unsigned long value[4] = {p[0], p[1], p[2], p[3]};
@@ -478,18 +542,6 @@ void ar9300_comp_hdr_unpack(const uint8_t *p, struct ar9300_comp_hdr *hdr)
 	hdr->min = value[3] & 0x00ff;
 }
 
-uint16_t ar9300_comp_cksum(const uint8_t *data, int dsize)
-{
-	int it, checksum = 0;
-
-	for (it = 0; it < dsize; it++) {
-		checksum += data[it];
-		checksum &= 0xffff;
-	}
-
-	return checksum;
-}
-
 static bool ar9300_uncompress_block(struct atheepmgr *aem, uint8_t *out,
 				    int out_size, const uint8_t *in, int in_len)
 {
@@ -508,9 +560,7 @@ static bool ar9300_uncompress_block(struct atheepmgr *aem, uint8_t *out,
 		length &= 0xff;
 
 		if (length > 0 && spot >= 0 && spot+length <= out_size) {
-			if (aem->verbose)
-				printf("Restore at %d: spot=%d offset=%d length=%d\n",
-				       it, spot, offset, length);
+			TRACE(9300_RESTORE_RUN, it, spot, offset, length);
 			memcpy(&out[spot], &in[it+2], length);
 			spot += length;
 		} else if (length > 0) {
@@ -527,7 +577,8 @@ static bool ar9300_uncompress_block(struct atheepmgr *aem, uint8_t *out,
 int ar9300_compress_decision(struct atheepmgr *aem, int it,
 			     struct ar9300_comp_hdr *hdr, uint8_t *out,
 			     const uint8_t *data, int out_size, int *pcurrref,
-			     const uint8_t *(*tpl_lookup_cb)(int))
+			     const uint8_t *(*tpl_lookup_cb)(struct atheepmgr *,
+							      int))
 {
 	bool res;
 
@@ -540,16 +591,14 @@ int ar9300_compress_decision(struct atheepmgr *aem, int it,
 			return -1;
 		}
 		memcpy(out, data, hdr->len);
-		if (aem->verbose)
-			printf("restored eeprom %d: uncompressed, length %d\n",
-			       it, hdr->len);
+		TRACE(9300_RESTORE_NONE, it, hdr->len);
 		break;
 
 	case AR9300_COMP_BLOCK:
 		if (hdr->ref != *pcurrref) {
 			const uint8_t *tpl;
 
-			tpl = tpl_lookup_cb(hdr->ref);
+			tpl = tpl_lookup_cb(aem, hdr->ref);
 			if (tpl == NULL) {
 				fprintf(stderr,
 					"can't find reference eeprom struct %d\n",
@@ -559,9 +608,7 @@ int ar9300_compress_decision(struct atheepmgr *aem, int it,
 			memcpy(out, tpl, out_size);
 			*pcurrref = hdr->ref;
 		}
-		if (aem->verbose)
-			printf("Restore eeprom %d: block, reference %d, length %d\n",
-			       it, hdr->ref, hdr->len);
+		TRACE(9300_RESTORE_BLOCK, it, hdr->ref, hdr->len);
 		res = ar9300_uncompress_block(aem, out, out_size,
 					      data, hdr->len);
 		if (!res)
@@ -622,14 +669,3 @@ void ar9300_dump_ctl(const uint8_t *index, const uint8_t *freqs,
 		printf("\n");
 	}
 }
-
-uint16_t eep_calc_csum(const uint16_t *buf, size_t len)
-{
-	uint16_t csum = 0;
-	size_t i;
-
-	for (i = 0; i < len; i++)
-		csum ^= *buf++;
-
-	return csum;
-}
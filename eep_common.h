@@ -194,6 +194,18 @@ bool __ar5416_toggle_byteswap(struct atheepmgr *aem, uint32_t eepmisc_off,
 				 AR ## __chip ## _DATA_START_LOC +	\
 				 offsetof(struct ar ## __chip ## _eeprom,\
 				          baseEepHeader.binBuildNumber) / 2)
+void __ar5416_toggle_byteswap_buf(struct atheepmgr *aem, uint32_t eepmisc_off,
+				  uint32_t binbuildnum_off);
+#define AR5416_TOGGLE_BYTESWAP_BUF(__chip)				\
+	__ar5416_toggle_byteswap_buf(aem,				\
+				     AR ## __chip ## _DATA_START_LOC +	\
+				     offsetof(struct ar ## __chip ## _eeprom,\
+					      baseEepHeader.eepMisc) / 2,\
+				     AR ## __chip ## _DATA_START_LOC +	\
+				     offsetof(struct ar ## __chip ## _eeprom,\
+					      baseEepHeader.binBuildNumber) / 2)
+
+bool eep_blob2buf(struct atheepmgr *aem, int len);
 
 void ar5416_dump_eep_init(const struct ar5416_eep_init *ini, size_t size);
 
@@ -214,16 +226,29 @@ void ar5416_dump_ctl(const uint8_t *index,
 #define EEP_FIELD_SIZE(__field)						\
 		(sizeof(eep->__field) / sizeof(uint16_t))
 
+bool ar9300_check_header(const void *data);
 void ar9300_comp_hdr_unpack(const uint8_t *p, struct ar9300_comp_hdr *hdr);
 uint16_t ar9300_comp_cksum(const uint8_t *data, int dsize);
 int ar9300_compress_decision(struct atheepmgr *aem, int it,
 			     struct ar9300_comp_hdr *hdr, uint8_t *out,
 			     const uint8_t *data, int out_size, int *pcurrref,
-			     const uint8_t *(*tpl_lookup_cb)(int));
+			     const uint8_t *(*tpl_lookup_cb)(struct atheepmgr *,
+							      int));
 
 void ar9300_dump_ctl(const uint8_t *index, const uint8_t *freqs,
 		     const uint8_t *data, int maxctl, int maxedges, int is_2g);
 
 uint16_t eep_calc_csum(const uint16_t *buf, size_t len);
 
+struct csum_impl {
+	const char *name;
+	uint16_t (*xor16)(const uint16_t *buf, size_t len);
+	uint16_t (*sum8)(const uint8_t *data, int dsize);
+	bool (*supported)(void);	/* NULL for always supported */
+};
+
+extern const struct csum_impl csum_impls[];
+
+const struct csum_impl *csum_impl_select(void);
+
 #endif /* EEP_COMMON_H */
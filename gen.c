@@ -0,0 +1,783 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "atheepmgr.h"
+#include "eep_common.h"
+#include "eep_5211.h"
+#include "eep_5416.h"
+#include "eep_9285.h"
+#include "eep_9287.h"
+#include "eep_9300.h"
+#include "eep_9880.h"
+#include "gen.h"
+
+/**
+ * Synthetic calibration data generator. Each image is built either from the
+ * first builtin template of a map or from scratch using the known map layout,
+ * then MAC, regulatory domain, calibration piers and target powers are
+ * randomised within valid ranges and checksums are fixed up, so the result is
+ * loaded and checked by the utility just like a real EEPROM dump.
+ *
+ * Generation is fully determined by the seed and the map name, so a corpus
+ * could be reproduced on any host.
+ */
+
+struct gen_rng {
+	uint64_t s;
+};
+
+/* SplitMix64 */
+static uint64_t gen_rand(struct gen_rng *r)
+{
+	uint64_t z = (r->s += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return z ^ (z >> 31);
+}
+
+/* Random value in the [lo, hi] range */
+static unsigned int gen_range(struct gen_rng *r, unsigned int lo,
+			      unsigned int hi)
+{
+	return lo + gen_rand(r) % (hi - lo + 1);
+}
+
+static void gen_rng_init(struct gen_rng *r, const char *name, uint64_t seed)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;	/* FNV-1a */
+
+	for (; *name; ++name)
+		h = (h ^ (uint8_t)*name) * 0x100000001b3ULL;
+	r->s = seed ^ h;
+}
+
+static void gen_mac(struct gen_rng *r, uint8_t *mac)
+{
+	int i;
+
+	do {
+		for (i = 0; i < 6; ++i)
+			mac[i] = gen_rand(r);
+		mac[0] &= 0xfc;		/* Unicast, globally administered */
+	} while (!mac[0] && !mac[1] && !mac[2]);
+}
+
+static uint16_t gen_regdmn(struct gen_rng *r)
+{
+	static const uint16_t regdmns[] = {
+		0x0000, 0x0010, 0x0030, 0x0037, 0x003a, 0x0060, 0x0064,
+		0x0068, 0x006a,
+	};
+
+	return regdmns[gen_range(r, 0, ARRAY_SIZE(regdmns) - 1)];
+}
+
+/**
+ * Select from min to max sorted channels of a band and store them as fbins,
+ * unused tail is filled with the specified value.
+ */
+static int gen_piers(struct gen_rng *r, uint8_t *piers, int min, int max,
+		     int is_2g, uint8_t unused)
+{
+	static const uint16_t chans_2g[] = {
+		2412, 2417, 2422, 2427, 2432, 2437, 2442, 2447, 2452, 2457,
+		2462, 2467, 2472, 2484,
+	};
+	static const uint16_t chans_5g[] = {
+		5180, 5200, 5220, 5240, 5260, 5280, 5300, 5320,
+		5500, 5520, 5540, 5560, 5580, 5600, 5620, 5640, 5660, 5680,
+		5700, 5745, 5765, 5785, 5805, 5825,
+	};
+	const uint16_t *chans = is_2g ? chans_2g : chans_5g;
+	int nchans = is_2g ? ARRAY_SIZE(chans_2g) : ARRAY_SIZE(chans_5g);
+	int i, n, num = gen_range(r, min, max);
+
+	/* Selection sampling keeps channels ordered */
+	for (i = 0, n = 0; i < nchans && n < num; ++i)
+		if (gen_range(r, 1, nchans - i) <= num - n)
+			piers[n++] = FREQ2FBIN(chans[i], is_2g);
+	for (i = n; i < max; ++i)
+		piers[i] = unused;
+
+	return n;
+}
+
+/* Non-increasing powers (0.5 dB units), the higher rate the lower power */
+static void gen_pow2x(struct gen_rng *r, uint8_t *pow, int num)
+{
+	int i, p = gen_range(r, 28, 40);
+
+	for (i = 0; i < num; ++i) {
+		pow[i] = p;
+		p -= gen_range(r, 0, 2);
+		if (p < 10)
+			p = 10;
+	}
+}
+
+/* Monotonic ramp, e.g. power detector curve */
+static void gen_ramp(struct gen_rng *r, uint8_t *val, int num, int start,
+		     int step_min, int step_max)
+{
+	int i, v = start;
+
+	for (i = 0; i < num; ++i) {
+		val[i] = v > 0xff ? 0xff : v;
+		v += gen_range(r, step_min, step_max);
+	}
+}
+
+static void gen_tgtpwr_leg(struct gen_rng *r,
+			   struct ar5416_cal_target_power_leg *tp, int max,
+			   int is_2g)
+{
+	uint8_t piers[8];
+	int i, n;
+
+	n = gen_piers(r, piers, (max + 1) / 2, max, is_2g, AR5416_BCHAN_UNUSED);
+	for (i = 0; i < max; ++i) {
+		tp[i].bChannel = piers[i];
+		if (i < n)
+			gen_pow2x(r, tp[i].tPow2x, ARRAY_SIZE(tp[i].tPow2x));
+		else
+			memset(tp[i].tPow2x, 0x00, sizeof(tp[i].tPow2x));
+	}
+}
+
+static void gen_tgtpwr_ht(struct gen_rng *r,
+			  struct ar5416_cal_target_power_ht *tp, int max,
+			  int is_2g)
+{
+	uint8_t piers[8];
+	int i, n;
+
+	n = gen_piers(r, piers, (max + 1) / 2, max, is_2g, AR5416_BCHAN_UNUSED);
+	for (i = 0; i < max; ++i) {
+		tp[i].bChannel = piers[i];
+		if (i < n)
+			gen_pow2x(r, tp[i].tPow2x, ARRAY_SIZE(tp[i].tPow2x));
+		else
+			memset(tp[i].tPow2x, 0x00, sizeof(tp[i].tPow2x));
+	}
+}
+
+/* Closed loop power detector data: each gain has own power and VPD curves */
+static void gen_pdcal(struct gen_rng *r, uint8_t *pwr, uint8_t *vpd,
+		      int ngains, int nicepts)
+{
+	int i;
+
+	for (i = 0; i < ngains; ++i) {
+		gen_ramp(r, &pwr[i * nicepts], nicepts,
+			 gen_range(r, 0, 8) + i * 12, 4, 12);
+		gen_ramp(r, &vpd[i * nicepts], nicepts,
+			 gen_range(r, 1, 20), 10, 30);
+	}
+}
+
+/**
+ * Checksum field value which makes XOR of all words equal to 0xffff, the
+ * field itself should be zeroed before the call.
+ */
+static uint16_t gen_csum(const void *data, size_t size)
+{
+	return eep_calc_csum(data, size / sizeof(uint16_t)) ^ 0xffff;
+}
+
+/* Magic is always stored in the Little-endian order */
+static void gen_magic(uint8_t *buf)
+{
+	buf[0] = 0x5a;
+	buf[1] = 0xa5;
+}
+
+/**
+ * AR5416 family maps (5416, 9285, 9287) share the base header fields naming,
+ * so fill them generically.
+ */
+#define GEN_AR5416_BASE(__r, __eep, __opflags, __chainmask)		\
+	do {								\
+		typeof((__eep)->baseEepHeader) *__b =			\
+						&(__eep)->baseEepHeader;\
+		__b->length = htole16(sizeof(*(__eep)));		\
+		__b->version = htole16(AR5416_EEP_VER << 12 |		\
+				       AR5416_EEP_MINOR_VER_21);	\
+		__b->opCapFlags = __opflags;				\
+		__b->regDmn[0] = htole16(gen_regdmn(__r));		\
+		__b->regDmn[1] = htole16(0x001f);			\
+		gen_mac(__r, __b->macAddr);				\
+		__b->rxMask = __chainmask;				\
+		__b->txMask = __chainmask;				\
+		__b->binBuildNumber = htole32(0x00090000 |		\
+					      gen_range(__r, 1, 0x30) << 8);\
+		__b->deviceType = 5;	/* PCIe */			\
+	} while (0)
+
+static int gen_ar5416_init(uint8_t *buf, int init_len)
+{
+	uint16_t *ini = (uint16_t *)buf;
+	int i;
+
+	gen_magic(buf);
+	ini[1] = htole16(0x0000);		/* Protection */
+	ini[2] = htole16(0x0003);		/* Init pointer */
+	for (i = 3; i < init_len; ++i)
+		ini[i] = 0xffff;
+
+	return init_len * sizeof(uint16_t);
+}
+
+static int gen_5416(struct gen_rng *r, enum gen_layout layout, uint8_t *buf,
+		    size_t size)
+{
+	struct ar5416_eeprom __eep, *eep = &__eep;
+	int off, i, j;
+
+	if (size < (AR5416_DATA_START_LOC + AR5416_DATA_SZ) * 2)
+		return -ENOSPC;
+
+	memset(eep, 0x00, sizeof(*eep));
+	GEN_AR5416_BASE(r, eep, AR5416_OPFLAGS_11A | AR5416_OPFLAGS_11G, 0x7);
+	eep->modalHeader5G.xpdGain = 0x6;
+	eep->modalHeader2G.xpdGain = 0x6;
+
+	gen_piers(r, eep->calFreqPier5G, 4, AR5416_NUM_5G_CAL_PIERS, 0,
+		  AR5416_BCHAN_UNUSED);
+	gen_piers(r, eep->calFreqPier2G, 2, AR5416_NUM_2G_CAL_PIERS, 1,
+		  AR5416_BCHAN_UNUSED);
+	for (i = 0; i < AR5416_MAX_CHAINS; ++i) {
+		for (j = 0; j < AR5416_NUM_5G_CAL_PIERS; ++j)
+			gen_pdcal(r, eep->calPierData5G[i][j].pwrPdg[0],
+				  eep->calPierData5G[i][j].vpdPdg[0], 2,
+				  AR5416_PD_GAIN_ICEPTS);
+		for (j = 0; j < AR5416_NUM_2G_CAL_PIERS; ++j)
+			gen_pdcal(r, eep->calPierData2G[i][j].pwrPdg[0],
+				  eep->calPierData2G[i][j].vpdPdg[0], 2,
+				  AR5416_PD_GAIN_ICEPTS);
+	}
+
+	gen_tgtpwr_leg(r, eep->calTargetPower5G,
+		       ARRAY_SIZE(eep->calTargetPower5G), 0);
+	gen_tgtpwr_ht(r, eep->calTargetPower5GHT20,
+		      ARRAY_SIZE(eep->calTargetPower5GHT20), 0);
+	gen_tgtpwr_ht(r, eep->calTargetPower5GHT40,
+		      ARRAY_SIZE(eep->calTargetPower5GHT40), 0);
+	gen_tgtpwr_leg(r, eep->calTargetPowerCck,
+		       ARRAY_SIZE(eep->calTargetPowerCck), 1);
+	gen_tgtpwr_leg(r, eep->calTargetPower2G,
+		       ARRAY_SIZE(eep->calTargetPower2G), 1);
+	gen_tgtpwr_ht(r, eep->calTargetPower2GHT20,
+		      ARRAY_SIZE(eep->calTargetPower2GHT20), 1);
+	gen_tgtpwr_ht(r, eep->calTargetPower2GHT40,
+		      ARRAY_SIZE(eep->calTargetPower2GHT40), 1);
+
+	eep->baseEepHeader.checksum = 0;
+	eep->baseEepHeader.checksum = gen_csum(eep, sizeof(*eep));
+
+	off = gen_ar5416_init(buf, AR5416_DATA_START_LOC);
+	memcpy(buf + off, eep, sizeof(*eep));
+
+	return off + sizeof(*eep);
+}
+
+static int gen_9285(struct gen_rng *r, enum gen_layout layout, uint8_t *buf,
+		    size_t size)
+{
+	struct ar9285_eeprom __eep, *eep = &__eep;
+	int off, i;
+
+	if (size < (AR9285_DATA_START_LOC + AR9285_DATA_SZ) * 2)
+		return -ENOSPC;
+
+	memset(eep, 0x00, sizeof(*eep));
+	GEN_AR5416_BASE(r, eep, AR5416_OPFLAGS_11G, 0x1);
+	eep->modalHeader.xpdGain = 0x6;
+
+	gen_piers(r, eep->calFreqPier2G, 2, AR9285_NUM_2G_CAL_PIERS, 1,
+		  AR5416_BCHAN_UNUSED);
+	for (i = 0; i < AR9285_NUM_2G_CAL_PIERS; ++i)
+		gen_pdcal(r, eep->calPierData2G[0][i].pwrPdg[0],
+			  eep->calPierData2G[0][i].vpdPdg[0],
+			  AR9285_NUM_PD_GAINS, AR5416_PD_GAIN_ICEPTS);
+
+	gen_tgtpwr_leg(r, eep->calTargetPowerCck,
+		       ARRAY_SIZE(eep->calTargetPowerCck), 1);
+	gen_tgtpwr_leg(r, eep->calTargetPower2G,
+		       ARRAY_SIZE(eep->calTargetPower2G), 1);
+	gen_tgtpwr_ht(r, eep->calTargetPower2GHT20,
+		      ARRAY_SIZE(eep->calTargetPower2GHT20), 1);
+	gen_tgtpwr_ht(r, eep->calTargetPower2GHT40,
+		      ARRAY_SIZE(eep->calTargetPower2GHT40), 1);
+
+	eep->baseEepHeader.checksum = 0;
+	eep->baseEepHeader.checksum = gen_csum(eep, sizeof(*eep));
+
+	off = gen_ar5416_init(buf, AR9285_DATA_START_LOC);
+	memcpy(buf + off, eep, sizeof(*eep));
+
+	return off + sizeof(*eep);
+}
+
+static int gen_9287(struct gen_rng *r, enum gen_layout layout, uint8_t *buf,
+		    size_t size)
+{
+	struct ar9287_eeprom __eep, *eep = &__eep;
+	struct ar9287_cal_data_per_freq *pd;
+	int off, i, j;
+
+	if (size < (AR9287_DATA_START_LOC + AR9287_DATA_SZ) * 2)
+		return -ENOSPC;
+
+	memset(eep, 0x00, sizeof(*eep));
+	GEN_AR5416_BASE(r, eep, AR5416_OPFLAGS_11G, 0x3);
+	eep->modalHeader.xpdGain = 0x6;
+
+	gen_piers(r, eep->calFreqPier2G, 2, AR9287_NUM_2G_CAL_PIERS, 1,
+		  AR5416_BCHAN_UNUSED);
+	for (i = 0; i < AR9287_MAX_CHAINS; ++i) {
+		for (j = 0; j < AR9287_NUM_2G_CAL_PIERS; ++j) {
+			pd = &eep->calPierData2G[i][j].calDataClose;
+			gen_pdcal(r, pd->pwrPdg[0], pd->vpdPdg[0],
+				  AR5416_NUM_PD_GAINS, AR9287_PD_GAIN_ICEPTS);
+		}
+	}
+
+	gen_tgtpwr_leg(r, eep->calTargetPowerCck,
+		       ARRAY_SIZE(eep->calTargetPowerCck), 1);
+	gen_tgtpwr_leg(r, eep->calTargetPower2G,
+		       ARRAY_SIZE(eep->calTargetPower2G), 1);
+	gen_tgtpwr_ht(r, eep->calTargetPower2GHT20,
+		      ARRAY_SIZE(eep->calTargetPower2GHT20), 1);
+	gen_tgtpwr_ht(r, eep->calTargetPower2GHT40,
+		      ARRAY_SIZE(eep->calTargetPower2GHT40), 1);
+
+	eep->baseEepHeader.checksum = 0;
+	eep->baseEepHeader.checksum = gen_csum(eep, sizeof(*eep));
+
+	off = gen_ar5416_init(buf, AR9287_DATA_START_LOC);
+	memcpy(buf + off, eep, sizeof(*eep));
+
+	return off + sizeof(*eep);
+}
+
+/* MSB first bit stream writer, the counterpart of EEP_GET_MSB() */
+struct gen_bit_stream {
+	uint16_t *words;
+	int off;
+	int havebits;
+	uint32_t buf;
+};
+
+static void gen_put_msb(struct gen_bit_stream *gbs, unsigned int val,
+			int bnum)
+{
+	gbs->buf = gbs->buf << bnum | (val & ((1 << bnum) - 1));
+	gbs->havebits += bnum;
+	while (gbs->havebits >= 16) {
+		gbs->havebits -= 16;
+		gbs->words[gbs->off++] = gbs->buf >> gbs->havebits;
+	}
+}
+
+static void gen_put_flush(struct gen_bit_stream *gbs)
+{
+	if (gbs->havebits)
+		gen_put_msb(gbs, 0, 16 - gbs->havebits);
+}
+
+/* Modal header bits up to the xPD gain (the rest is left zeroed) */
+static void gen_5211_modal(struct gen_rng *r, uint16_t *eep, int off,
+			   int is_a)
+{
+	static const uint8_t xpd_gains[] = {0x07, 0x0b, 0x0d, 0x0e};
+	struct gen_bit_stream gbs = {.words = eep, .off = off};
+	int i;
+
+	gen_put_msb(&gbs, 0, 1);			/* Unused bit */
+	gen_put_msb(&gbs, gen_range(r, 0x20, 0x30), 7);	/* Switch settling */
+	gen_put_msb(&gbs, gen_range(r, 0x10, 0x20), 6);	/* TxRx atten. */
+	for (i = 0; i < 11; ++i)			/* Antenna control */
+		gen_put_msb(&gbs, gen_range(r, 0, 0x3f), 6);
+	gen_put_msb(&gbs, (uint8_t)-32, 8);		/* ADC desired size */
+	if (is_a) {
+		for (i = 0; i < 4 * 2; ++i)		/* Per band OB & DB */
+			gen_put_msb(&gbs, gen_range(r, 1, 7), 3);
+	} else {
+		gen_put_msb(&gbs, gen_range(r, 1, 7), 4);	/* OB */
+		gen_put_msb(&gbs, gen_range(r, 1, 7), 4);	/* DB */
+	}
+	for (i = 0; i < 6; ++i)				/* Timings, thresholds */
+		gen_put_msb(&gbs, gen_range(r, 0, 0x40), 8);
+	gen_put_msb(&gbs, 0, 2);			/* Unused bits */
+	gen_put_msb(&gbs, 0, 1);			/* Fixed bias */
+	gen_put_msb(&gbs, gen_range(r, 0, 0x20), 8);	/* xLNA gain */
+	gen_put_msb(&gbs, xpd_gains[gen_range(r, 0, 3)], 4);
+	gen_put_msb(&gbs, 1, 1);			/* xPD */
+	gen_put_flush(&gbs);
+}
+
+/* Map 0 pier data: VPD min/max and 11 power points */
+static void gen_5211_pdcal_pier(struct gen_rng *r, struct gen_bit_stream *gbs)
+{
+	uint8_t pwr[11];
+	int i;
+
+	gen_ramp(r, pwr, ARRAY_SIZE(pwr), gen_range(r, 2, 8), 1, 3);
+	gen_put_msb(gbs, gen_range(r, 40, 60), 6);	/* VPD max */
+	gen_put_msb(gbs, gen_range(r, 5, 15), 6);	/* VPD min */
+	for (i = 0; i < ARRAY_SIZE(pwr); ++i)
+		gen_put_msb(gbs, pwr[i], 6);
+	gen_put_msb(gbs, 0, 2);				/* Unused bits */
+}
+
+static void gen_5211_tgtpwr_set(struct gen_rng *r,
+				struct gen_bit_stream *gbs, int max, int is_2g)
+{
+	uint8_t piers[AR5211_MAX_TGTPWR_CHANS_A], pow[AR5211_NUM_TGTPWR_RATES];
+	int i, j, n;
+
+	n = gen_piers(r, piers, 1, max, is_2g, 0);
+	for (i = 0; i < max; ++i) {
+		if (i < n)
+			gen_pow2x(r, pow, ARRAY_SIZE(pow));
+		else
+			memset(pow, 0x00, sizeof(pow));
+		gen_put_msb(gbs, piers[i], 8);
+		for (j = 0; j < ARRAY_SIZE(pow); ++j)
+			gen_put_msb(gbs, pow[j], 6);
+	}
+}
+
+/**
+ * Generate a minimal v3.3 EEPROM image of default size with the map 0 PD
+ * calibration layout (CTLs are left zeroed).
+ */
+static int gen_5211(struct gen_rng *r, enum gen_layout layout, uint8_t *buf,
+		    size_t size)
+{
+	uint16_t eep[AR5211_SIZE_DEF];
+	struct gen_bit_stream __gbs, *gbs = &__gbs;
+	uint8_t mac[6], piers[AR5211_NUM_PDCAL_PIERS_A];
+	int i, n;
+
+	if (size < sizeof(eep))
+		return -ENOSPC;
+
+	memset(eep, 0x00, sizeof(eep));
+	eep[AR5211_EEP_MAGIC] = AR5211_EEPROM_MAGIC_VAL;
+
+	gen_mac(r, mac);
+	eep[AR5211_EEP_MAC + 0] = mac[4] << 8 | mac[5];
+	eep[AR5211_EEP_MAC + 1] = mac[2] << 8 | mac[3];
+	eep[AR5211_EEP_MAC + 2] = mac[0] << 8 | mac[1];
+	eep[AR5211_EEP_REGDOMAIN] = gen_regdmn(r);
+
+	eep[AR5211_EEP_VER] = AR5211_EEP_VER_3_3;
+	eep[AR5211_EEP_OPFLAGS] = AR5211_EEP_AMODE | AR5211_EEP_BMODE |
+				  AR5211_EEP_GMODE |
+				  3 << AR5211_EEP_DEVTYPE_S;	/* PCI */
+	eep[AR5211_EEP_ANTGAIN_33] = gen_range(r, 0, 6) << AR5211_EEP_ANTGAIN_5G_S |
+				     gen_range(r, 0, 4) << AR5211_EEP_ANTGAIN_2G_S;
+
+	gen_5211_modal(r, eep, AR5211_EEP_MODAL_A_33, 1);
+	gen_5211_modal(r, eep, AR5211_EEP_MODAL_B_33, 0);
+	gen_5211_modal(r, eep, AR5211_EEP_MODAL_G_33, 0);
+
+	memset(gbs, 0x00, sizeof(*gbs));
+	gbs->words = eep;
+	gbs->off = AR5211_EEP_PDCAL_BASE_33;
+	n = gen_piers(r, piers, 4, ARRAY_SIZE(piers), 0, 0);
+	for (i = 0; i < ARRAY_SIZE(piers); ++i)
+		gen_put_msb(gbs, piers[i], 8);
+	for (i = 0; i < n + 3 + 3; ++i)		/* A, B and G piers */
+		gen_5211_pdcal_pier(r, gbs);
+	gen_put_flush(gbs);
+
+	gbs->off = AR5211_EEP_TGTPWR_BASE_33;
+	gen_5211_tgtpwr_set(r, gbs, AR5211_MAX_TGTPWR_CHANS_A, 0);
+	gen_5211_tgtpwr_set(r, gbs, AR5211_MAX_TGTPWR_CHANS_B, 1);
+	gen_5211_tgtpwr_set(r, gbs, AR5211_MAX_TGTPWR_CHANS_G, 1);
+	gen_put_flush(gbs);
+
+	eep[AR5211_EEP_CSUM] = gen_csum(&eep[AR5211_EEP_INFO_BASE],
+					sizeof(eep) - AR5211_EEP_INFO_BASE *
+						      sizeof(uint16_t));
+
+	for (i = 0; i < ARRAY_SIZE(eep); ++i)
+		eep[i] = htole16(eep[i]);
+	memcpy(buf, eep, sizeof(eep));
+
+	return sizeof(eep);
+}
+
+static void gen_9300_tgtpwr(struct gen_rng *r, uint8_t *freqs, uint8_t *pow,
+			    int num, int nrates, int is_2g)
+{
+	int i;
+
+	gen_piers(r, freqs, num, num, is_2g, 0);
+	for (i = 0; i < num; ++i)
+		gen_pow2x(r, &pow[i * nrates], nrates);
+}
+
+static void gen_9300_piers(struct gen_rng *r, uint8_t *piers,
+			   struct ar9300_cal_data_per_freq_op_loop *data,
+			   int num, int is_2g)
+{
+	int i;
+
+	gen_piers(r, piers, num, num, is_2g, 0);
+	for (i = 0; i < num * AR9300_MAX_CHAINS; ++i) {
+		data[i].refPower = gen_range(r, 2, 20);
+		data[i].voltMeas = gen_range(r, 110, 140);
+		data[i].tempMeas = gen_range(r, 100, 140);
+	}
+}
+
+static bool gen_9300_differ(const uint8_t *data, const uint8_t *ref, int i)
+{
+	return data[i] != ref[i];
+}
+
+/**
+ * Encode differences of the data from the reference in [start, end) range
+ * as a block compression stream: a sequence of (offset, length, octets)
+ * runs, where offset is counted from the end of a previous run. Short
+ * unchanged gaps are absorbed since they are cheaper than a run header.
+ */
+static int gen_9300_blk_encode(const uint8_t *data, const uint8_t *ref,
+			       int start, int end, uint8_t *out, int outsz)
+{
+	int pos, len, spot = 0, n = 0;
+
+	for (pos = start; pos < end; ) {
+		if (!gen_9300_differ(data, ref, pos)) {
+			pos++;
+			continue;
+		}
+		for (len = 1; pos + len < end && len < 0xff; ++len) {
+			if (gen_9300_differ(data, ref, pos + len))
+				continue;
+			if (pos + len + 2 < end && len + 2 < 0xff &&
+			    (gen_9300_differ(data, ref, pos + len + 1) ||
+			     gen_9300_differ(data, ref, pos + len + 2)))
+				continue;
+			break;
+		}
+		for (; pos - spot > 0xff; spot += 0xff) {
+			if (n + 2 > outsz)
+				return -ENOSPC;
+			out[n++] = 0xff;	/* Skip without data */
+			out[n++] = 0;
+		}
+		if (n + 2 + len > outsz)
+			return -ENOSPC;
+		out[n++] = pos - spot;
+		out[n++] = len;
+		memcpy(&out[n], &data[pos], len);
+		n += len;
+		pos += len;
+		spot = pos;
+	}
+
+	return n;
+}
+
+/**
+ * Randomise the default template and store differences as several block
+ * compressed chunks, which are placed downwards from the base address just
+ * like the calibration software does this.
+ */
+static int gen_9300(struct gen_rng *r, const struct eepmap *eepmap,
+		    enum gen_layout layout, uint8_t *buf, size_t size)
+{
+	const struct eeptemplate *tpl = &eepmap->templates[0];
+	const int dlen = sizeof(struct ar9300_eeprom);
+	const int bottom = layout == GEN_LAYOUT_EEPROM ? 2 : 0;
+	struct ar9300_eeprom __eep, *eep = &__eep;
+	uint8_t blk[AR9300_COMP_HDR_LEN + 0x7ff + AR9300_COMP_CKSUM_LEN];
+	int nblks, cptr, start, end, len, i, k;
+	uint16_t sum;
+
+	if (size < AR9300_BASE_ADDR + 1)
+		return -ENOSPC;
+
+	memcpy(eep, tpl->data, sizeof(*eep));
+	gen_mac(r, eep->macAddr);
+	eep->baseEepHeader.regDmn[0] = htole16(gen_regdmn(r));
+
+	gen_9300_piers(r, eep->calFreqPier2G, eep->calPierData2G[0],
+		       AR9300_NUM_2G_CAL_PIERS, 1);
+	gen_9300_piers(r, eep->calFreqPier5G, eep->calPierData5G[0],
+		       AR9300_NUM_5G_CAL_PIERS, 0);
+
+	gen_9300_tgtpwr(r, eep->calTarget_freqbin_Cck,
+			eep->calTargetPowerCck[0].tPow2x,
+			AR9300_NUM_2G_CCK_TARGET_POWERS, 4, 1);
+	gen_9300_tgtpwr(r, eep->calTarget_freqbin_2G,
+			eep->calTargetPower2G[0].tPow2x,
+			AR9300_NUM_2G_20_TARGET_POWERS, 4, 1);
+	gen_9300_tgtpwr(r, eep->calTarget_freqbin_2GHT20,
+			eep->calTargetPower2GHT20[0].tPow2x,
+			AR9300_NUM_2G_20_TARGET_POWERS, 14, 1);
+	gen_9300_tgtpwr(r, eep->calTarget_freqbin_2GHT40,
+			eep->calTargetPower2GHT40[0].tPow2x,
+			AR9300_NUM_2G_40_TARGET_POWERS, 14, 1);
+	gen_9300_tgtpwr(r, eep->calTarget_freqbin_5G,
+			eep->calTargetPower5G[0].tPow2x,
+			AR9300_NUM_5G_20_TARGET_POWERS, 4, 0);
+	gen_9300_tgtpwr(r, eep->calTarget_freqbin_5GHT20,
+			eep->calTargetPower5GHT20[0].tPow2x,
+			AR9300_NUM_5G_20_TARGET_POWERS, 14, 0);
+	gen_9300_tgtpwr(r, eep->calTarget_freqbin_5GHT40,
+			eep->calTargetPower5GHT40[0].tPow2x,
+			AR9300_NUM_5G_40_TARGET_POWERS, 14, 0);
+
+	memset(buf, 0x00, AR9300_BASE_ADDR + 1);
+	if (layout == GEN_LAYOUT_EEPROM)
+		gen_magic(buf);
+
+	nblks = gen_range(r, 2, 4);
+	cptr = AR9300_BASE_ADDR;
+	for (i = 0, start = 0; i < nblks; ++i, start = end) {
+		end = (i + 1) * dlen / nblks;
+		len = gen_9300_blk_encode((uint8_t *)eep, tpl->data, start,
+					  end, blk + AR9300_COMP_HDR_LEN, 0x7ff);
+		if (len <= 0)	/* Nothing to store or no room */
+			continue;
+
+		blk[0] = AR9300_COMP_BLOCK << 5 | (tpl->id & 0x1f);
+		blk[1] = (tpl->id & 0x20) << 2 | (len >> 4 & 0x7f);
+		blk[2] = (len & 0x0f) << 4 | (eep->eepromVersion & 0x0f);
+		blk[3] = eep->templateVersion;
+		sum = ar9300_comp_cksum(blk + AR9300_COMP_HDR_LEN, len);
+		blk[AR9300_COMP_HDR_LEN + len + 0] = sum & 0xff;
+		blk[AR9300_COMP_HDR_LEN + len + 1] = sum >> 8;
+		len += AR9300_COMP_HDR_LEN + AR9300_COMP_CKSUM_LEN;
+
+		if (cptr - len < bottom + AR9300_COMP_HDR_LEN) {
+			fprintf(stderr, "gen: compressed %s data does not fit into %d octets\n",
+				eepmap->name, AR9300_BASE_ADDR + 1);
+			return -ENOSPC;
+		}
+
+		/* Stream is stored in the reversed octets order */
+		for (k = 0; k < len; ++k)
+			buf[cptr - k] = blk[k];
+		cptr -= len;
+	}
+
+	return AR9300_BASE_ADDR + 1;
+}
+
+static void gen_9880_tgtpwr_vht(struct gen_rng *r, uint8_t *freqs,
+				struct qca9880_cal_tgt_pow_vht *tp, int num,
+				int is_2g)
+{
+	int i;
+
+	gen_piers(r, freqs, num, num, is_2g, 0);
+	for (i = 0; i < num; ++i)
+		gen_pow2x(r, tp[i].tPow2xBase, ARRAY_SIZE(tp[i].tPow2xBase));
+}
+
+static int gen_9880(struct gen_rng *r, const struct eepmap *eepmap,
+		    enum gen_layout layout, uint8_t *buf, size_t size)
+{
+	struct qca9880_eeprom __eep, *eep = &__eep;
+
+	if (size < sizeof(*eep))
+		return -ENOSPC;
+
+	memcpy(eep, eepmap->templates[0].data, sizeof(*eep));
+	gen_mac(r, eep->baseEepHeader.macAddr);
+	eep->baseEepHeader.regDmn[0] = htole16(gen_regdmn(r));
+
+	gen_piers(r, eep->calFreqPier2G, QCA9880_NUM_2G_CAL_PIERS,
+		  QCA9880_NUM_2G_CAL_PIERS, 1, 0);
+	gen_piers(r, eep->calFreqPier5G, QCA9880_NUM_5G_CAL_PIERS,
+		  QCA9880_NUM_5G_CAL_PIERS, 0, 0);
+
+	gen_9300_tgtpwr(r, eep->targetFreqbin2GCck,
+			eep->targetPower2GCck[0].tPow2x,
+			QCA9880_TGTPWR_CCK_2G_NUM_FREQS, 4, 1);
+	gen_9300_tgtpwr(r, eep->targetFreqbin2GLeg,
+			eep->targetPower2GLeg[0].tPow2x,
+			QCA9880_TGTPWR_LEG_2G_NUM_FREQS, 4, 1);
+	gen_9880_tgtpwr_vht(r, eep->targetFreqbin2GVHT20,
+			    eep->targetPower2GVHT20,
+			    QCA9880_TGTPWR_VHT_2G_NUM_FREQS, 1);
+	gen_9880_tgtpwr_vht(r, eep->targetFreqbin2GVHT40,
+			    eep->targetPower2GVHT40,
+			    QCA9880_TGTPWR_VHT_2G_NUM_FREQS, 1);
+	gen_9300_tgtpwr(r, eep->targetFreqbin5GLeg,
+			eep->targetPower5GLeg[0].tPow2x,
+			QCA9880_TGTPWR_LEG_5G_NUM_FREQS, 4, 0);
+	gen_9880_tgtpwr_vht(r, eep->targetFreqbin5GVHT20,
+			    eep->targetPower5GVHT20,
+			    QCA9880_TGTPWR_VHT_5G_NUM_FREQS, 0);
+	gen_9880_tgtpwr_vht(r, eep->targetFreqbin5GVHT40,
+			    eep->targetPower5GVHT40,
+			    QCA9880_TGTPWR_VHT_5G_NUM_FREQS, 0);
+	gen_9880_tgtpwr_vht(r, eep->targetFreqbin5GVHT80,
+			    eep->targetPower5GVHT80,
+			    QCA9880_TGTPWR_VHT_5G_NUM_FREQS, 0);
+
+	eep->baseEepHeader.checksum = 0;
+	eep->baseEepHeader.checksum = gen_csum(eep, sizeof(*eep));
+	memcpy(buf, eep, sizeof(*eep));
+
+	return sizeof(*eep);
+}
+
+static int gen_dispatch(struct gen_rng *r, const struct eepmap *eepmap,
+			enum gen_layout layout, uint8_t *buf, size_t size)
+{
+	const char *name = eepmap->name;
+
+	if (strcmp(name, "9300") == 0)
+		return gen_9300(r, eepmap, layout, buf, size);
+	if (layout != GEN_LAYOUT_EEPROM)
+		return 0;
+	if (strcmp(name, "5211") == 0)
+		return gen_5211(r, layout, buf, size);
+	if (strcmp(name, "5416") == 0)
+		return gen_5416(r, layout, buf, size);
+	if (strcmp(name, "9285") == 0)
+		return gen_9285(r, layout, buf, size);
+	if (strcmp(name, "9287") == 0)
+		return gen_9287(r, layout, buf, size);
+	if (strcmp(name, "9880") == 0)
+		return gen_9880(r, eepmap, layout, buf, size);
+
+	return 0;
+}
+
+/**
+ * Generate an image for the specified map, returns the image length, zero
+ * if the map (or the layout) is not supported or a negative error code.
+ */
+int gen_image(const struct eepmap *eepmap, enum gen_layout layout,
+	      uint64_t seed, uint8_t *buf, size_t size)
+{
+	struct gen_rng r;
+
+	gen_rng_init(&r, eepmap->name, seed);
+
+	return gen_dispatch(&r, eepmap, layout, buf, size);
+}
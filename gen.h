@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef GEN_H
+#define GEN_H
+
+#define GEN_IMAGE_MAX		0x4000	/* Max generated image size, bytes */
+
+enum gen_layout {
+	GEN_LAYOUT_EEPROM,	/* EEPROM contents (or a blob) */
+	GEN_LAYOUT_OTP,		/* OTP memory contents */
+};
+
+int gen_image(const struct eepmap *eepmap, enum gen_layout layout,
+	      uint64_t seed, uint8_t *buf, size_t size);
+
+#endif	/* GEN_H */
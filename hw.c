@@ -15,6 +15,8 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+#include <time.h>
+
 #include "atheepmgr.h"
 #include "hw.h"
 
@@ -123,40 +125,162 @@ static void hw_read_revisions(struct atheepmgr *aem)
 	}
 }
 
+/**
+ * Device health tracking. A vanished device reads as all-ones and a wedged one
+ * never completes operations, each such event is counted as an I/O error.
+ * After the errors budget is exhausted or the operation deadline expired, the
+ * device is considered dead and any further access fails immediately instead
+ * of waiting for the timeout of each operation. The state is tracked per
+ * operation (a command line action or a session request).
+ */
+void hw_io_error(struct atheepmgr *aem)
+{
+	aem->hw_errs++;
+	if (aem->hw_dead || !aem->hw_err_budget ||
+	    aem->hw_errs < aem->hw_err_budget)
+		return;
+
+	fprintf(stderr, "Device is not responding (%u I/O errors), abort any further access\n",
+		aem->hw_errs);
+	aem->hw_dead = true;
+}
+
+/* All-ones read result, check whether the chip is still here */
+void hw_reg_check_ones(struct atheepmgr *aem, uint32_t reg)
+{
+	uint32_t srev = aem->eepmap ? aem->eepmap->chip_regs.srev : 0;
+
+	/* SREV register of an alive chip never reads as all-ones */
+	if (srev && reg != srev && __hw_reg_read(aem, srev) != ~0U)
+		return;
+
+	hw_io_error(aem);
+}
+
+static uint64_t hw_time_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Start a new operation: reset the device health and arm the deadline */
+void hw_op_start(struct atheepmgr *aem)
+{
+	aem->hw_errs = 0;
+	aem->hw_dead = false;
+	aem->hw_deadline = aem->hw_timeout ? hw_time_ms() + aem->hw_timeout :
+					     0;
+}
+
+bool hw_is_alive(struct atheepmgr *aem)
+{
+	if (aem->hw_dead)
+		return false;
+
+	if (aem->hw_deadline && hw_time_ms() >= aem->hw_deadline) {
+		fprintf(stderr, "Operation deadline expired, abort any further device access\n");
+		aem->hw_dead = true;
+		return false;
+	}
+
+	return true;
+}
+
 bool hw_wait(struct atheepmgr *aem, uint32_t reg, uint32_t mask,
 	     uint32_t val, uint32_t timeout)
 {
 	int i;
 
+	if (!hw_is_alive(aem)) {
+		PROBE(hw_wait, reg, mask, val, 0, 0);
+		return false;
+	}
+
+#if !defined(CONFIG_CON_MMIO_INLINE)
+	/* Let the connector poll without a round trip per iteration */
+	if (aem->con->wait) {
+		bool res = aem->con->wait(aem, reg, mask, val, timeout);
+
+		if (!res)
+			hw_io_error(aem);
+		PROBE(hw_wait, reg, mask, val, 0, res);
+		return res;
+	}
+#endif
+
 	for (i = 0; i < (timeout / AH_TIME_QUANTUM); i++) {
-		if ((REG_READ(reg) & mask) == val)
+		if ((REG_READ(reg) & mask) == val) {
+			PROBE(hw_wait, reg, mask, val, i, 1);
 			return true;
+		}
+
+		if (!hw_is_alive(aem))
+			break;
 
 		usleep(AH_TIME_QUANTUM);
 	}
 
+	hw_io_error(aem);	/* Device is wedged or vanished */
+
+	PROBE(hw_wait, reg, mask, val, i, 0);
+
 	return false;
 }
 
-static int hw_gpio_input_get_ar9xxx(struct atheepmgr *aem, unsigned gpio)
+void hw_reg_bulk_read(struct atheepmgr *aem, uint32_t reg, uint32_t *vals,
+		      unsigned int num)
 {
-	uint32_t regval = REG_READ(AR9XXX_GPIO_IN_OUT);
+	unsigned int i;
 
-	if (gpio >= aem->gpio_num)
-		return 0;
+	if (aem->hw_dead) {
+		memset(vals, 0xff, num * sizeof(*vals));
+		return;
+	}
+
+	if (aem->con->reg_bulk_read &&
+	    aem->con->reg_bulk_read(aem, reg, vals, num) == 0) {
+		PROBE(reg_bulk_read, reg, num, 1);
+		return;
+	}
+
+	for (i = 0; i < num; ++i)
+		vals[i] = REG_READ(reg + i * sizeof(uint32_t));
 
+	PROBE(reg_bulk_read, reg, num, 0);
+}
+
+static uint32_t hw_gpio_in_val_ar9xxx(struct atheepmgr *aem, uint32_t regval)
+{
 	if (AR_SREV_9300_20_OR_LATER(aem))
-		regval = MS(regval, AR9300_GPIO_IN_VAL);
+		return MS(regval, AR9300_GPIO_IN_VAL);
 	else if (AR_SREV_9287_11_OR_LATER(aem))
-		regval = MS(regval, AR9287_GPIO_IN_VAL);
+		return MS(regval, AR9287_GPIO_IN_VAL);
 	else if (AR_SREV_9285_12_OR_LATER(aem))
-		regval = MS(regval, AR9285_GPIO_IN_VAL);
+		return MS(regval, AR9285_GPIO_IN_VAL);
 	else if (AR_SREV_9280_20_OR_LATER(aem))
-		regval = MS(regval, AR9280_GPIO_IN_VAL);
+		return MS(regval, AR9280_GPIO_IN_VAL);
 	else
-		regval = MS(regval, AR5416_GPIO_IN_VAL);
+		return MS(regval, AR5416_GPIO_IN_VAL);
+}
 
-	return !!(regval & BIT(gpio));
+static int hw_gpio_input_get_ar9xxx(struct atheepmgr *aem, unsigned gpio)
+{
+	uint32_t regval = REG_READ(AR9XXX_GPIO_IN_OUT);
+
+	if (gpio >= aem->gpio_num)
+		return 0;
+
+	return !!(hw_gpio_in_val_ar9xxx(aem, regval) & BIT(gpio));
+}
+
+static uint32_t hw_gpio_inputs_get_ar9xxx(struct atheepmgr *aem)
+{
+	uint32_t regval = REG_READ(AR9XXX_GPIO_IN_OUT);
+
+	return hw_gpio_in_val_ar9xxx(aem, regval) & (BIT(aem->gpio_num) - 1);
 }
 
 static int hw_gpio_output_get_ar9xxx(struct atheepmgr *aem, unsigned gpio)
@@ -219,11 +343,8 @@ static void hw_gpio_out_mux_set_ar9xxx(struct atheepmgr *aem, unsigned gpio,
 	}
 }
 
-static const char *hw_gpio_out_mux_get_str_ar9xxx(struct atheepmgr *aem,
-						  unsigned gpio)
+static const char *hw_gpio_out_mux_str_ar9xxx(int type)
 {
-	int type = hw_gpio_out_mux_get_ar9xxx(aem, gpio);
-
 	switch (type) {
 	case AR9XXX_GPIO_OUTPUT_MUX_OUTPUT:
 		return "Out";
@@ -240,6 +361,12 @@ static const char *hw_gpio_out_mux_get_str_ar9xxx(struct atheepmgr *aem,
 	return "Unk";
 }
 
+static const char *hw_gpio_out_mux_get_str_ar9xxx(struct atheepmgr *aem,
+						  unsigned gpio)
+{
+	return hw_gpio_out_mux_str_ar9xxx(hw_gpio_out_mux_get_ar9xxx(aem, gpio));
+}
+
 static int hw_gpio_dir_get_ar9xxx(struct atheepmgr *aem, unsigned gpio)
 {
 	unsigned sh = gpio * 2;
@@ -264,11 +391,8 @@ static void hw_gpio_dir_set_out_ar9xxx(struct atheepmgr *aem, unsigned gpio)
 		AR9XXX_GPIO_OE_OUT_DRV << sh);
 }
 
-static const char *hw_gpio_dir_get_str_ar9xxx(struct atheepmgr *aem,
-					      unsigned gpio)
+static const char *hw_gpio_dir_str_ar9xxx(int dir)
 {
-	int dir = hw_gpio_dir_get_ar9xxx(aem, gpio);
-
 	switch (dir) {
 	case AR9XXX_GPIO_OE_OUT_DRV_NO:
 		return "In";
@@ -283,13 +407,50 @@ static const char *hw_gpio_dir_get_str_ar9xxx(struct atheepmgr *aem,
 	return "Unk";
 }
 
+static const char *hw_gpio_dir_get_str_ar9xxx(struct atheepmgr *aem,
+					      unsigned gpio)
+{
+	return hw_gpio_dir_str_ar9xxx(hw_gpio_dir_get_ar9xxx(aem, gpio));
+}
+
+/* Read each GPIO register once and decode all lines from these values */
+static void hw_gpio_snapshot_ar9xxx(struct atheepmgr *aem,
+				    struct gpio_snapshot *snap)
+{
+	const uint32_t mux_regs[] = {
+		AR9XXX_GPIO_OUTPUT_MUX1,
+		AR9XXX_GPIO_OUTPUT_MUX2,
+		AR9XXX_GPIO_OUTPUT_MUX3,
+	};
+	uint32_t inout, oe, mux = 0;
+	unsigned i, sh;
+
+	inout = REG_READ(AR9XXX_GPIO_IN_OUT);
+	oe = REG_READ(AR9XXX_GPIO_OE_OUT);
+
+	snap->input = hw_gpio_in_val_ar9xxx(aem, inout);
+	snap->output = inout;
+	for (i = 0; i < aem->gpio_num; ++i) {
+		if (i % 6 == 0)
+			mux = REG_READ(mux_regs[i / 6]);
+		sh = i * 2;
+		snap->dir_str[i] = hw_gpio_dir_str_ar9xxx((oe >> sh) &
+							  AR9XXX_GPIO_OE_OUT_DRV);
+		sh = (i % 6) * 5;
+		snap->out_mux_str[i] = hw_gpio_out_mux_str_ar9xxx((mux >> sh) &
+						AR9XXX_GPIO_OUTPUT_MUX_MASK);
+	}
+}
+
 static const struct gpio_ops gpio_ops_ar9xxx = {
 	.input_get = hw_gpio_input_get_ar9xxx,
+	.inputs_get = hw_gpio_inputs_get_ar9xxx,
 	.output_get = hw_gpio_output_get_ar9xxx,
 	.output_set = hw_gpio_output_set_ar9xxx,
 	.dir_set_out = hw_gpio_dir_set_out_ar9xxx,
 	.dir_get_str = hw_gpio_dir_get_str_ar9xxx,
 	.out_mux_get_str = hw_gpio_out_mux_get_str_ar9xxx,
+	.snapshot = hw_gpio_snapshot_ar9xxx,
 };
 
 static bool hw_eeprom_read_9xxx(struct atheepmgr *aem, uint32_t off,
@@ -340,6 +501,11 @@ static int hw_gpio_input_get_ar5xxx(struct atheepmgr *aem, unsigned gpio)
 	return !!(REG_READ(AR5XXX_GPIO_IN) & BIT(gpio));
 }
 
+static uint32_t hw_gpio_inputs_get_ar5xxx(struct atheepmgr *aem)
+{
+	return REG_READ(AR5XXX_GPIO_IN) & (BIT(aem->gpio_num) - 1);
+}
+
 static int hw_gpio_output_get_ar5xxx(struct atheepmgr *aem, unsigned gpio)
 {
 	if (gpio >= aem->gpio_num)
@@ -376,11 +542,8 @@ static void hw_gpio_dir_set_out_ar5xxx(struct atheepmgr *aem, unsigned gpio)
 		AR5XXX_GPIO_CTRL_DRV << sh);
 }
 
-static const char *hw_gpio_dir_get_str_ar5xxx(struct atheepmgr *aem,
-					      unsigned gpio)
+static const char *hw_gpio_dir_str_ar5xxx(int dir)
 {
-	int dir = hw_gpio_dir_get_ar5xxx(aem, gpio);
-
 	switch (dir) {
 	case AR5XXX_GPIO_CTRL_DRV_NO:
 		return "In";
@@ -395,12 +558,36 @@ static const char *hw_gpio_dir_get_str_ar5xxx(struct atheepmgr *aem,
 	return "Unk";
 }
 
+static const char *hw_gpio_dir_get_str_ar5xxx(struct atheepmgr *aem,
+					      unsigned gpio)
+{
+	return hw_gpio_dir_str_ar5xxx(hw_gpio_dir_get_ar5xxx(aem, gpio));
+}
+
+static void hw_gpio_snapshot_ar5xxx(struct atheepmgr *aem,
+				    struct gpio_snapshot *snap)
+{
+	uint32_t ctrl;
+	unsigned i;
+
+	snap->input = REG_READ(AR5XXX_GPIO_IN);
+	snap->output = REG_READ(AR5XXX_GPIO_OUT);
+	ctrl = REG_READ(AR5XXX_GPIO_CTRL);
+	for (i = 0; i < aem->gpio_num; ++i) {
+		snap->dir_str[i] = hw_gpio_dir_str_ar5xxx((ctrl >> (i * 2)) &
+							  AR5XXX_GPIO_CTRL_DRV);
+		snap->out_mux_str[i] = NULL;
+	}
+}
+
 static const struct gpio_ops gpio_ops_ar5xxx = {
 	.input_get = hw_gpio_input_get_ar5xxx,
+	.inputs_get = hw_gpio_inputs_get_ar5xxx,
 	.output_get = hw_gpio_output_get_ar5xxx,
 	.output_set = hw_gpio_output_set_ar5xxx,
 	.dir_set_out = hw_gpio_dir_set_out_ar5xxx,
 	.dir_get_str = hw_gpio_dir_get_str_ar5xxx,
+	.snapshot = hw_gpio_snapshot_ar5xxx,
 };
 
 static bool hw_eeprom_read_5211(struct atheepmgr *aem, uint32_t off, uint16_t *data)
@@ -563,6 +750,9 @@ void hw_eeprom_set_ops(struct atheepmgr *aem)
 		if (aem->verbose)
 			printf("EEPROM access ops: use connector's ops\n");
 		aem->eep = aem->con->eep;
+	} else if (!(aem->con->caps & CON_CAP_HW)) {
+		if (aem->verbose)
+			printf("EEPROM access ops: connector provides blob only\n");
 	} else if (AR_SREV_AFTER_9550(aem)) {
 		if (aem->verbose)
 			printf("Chip does not support EEPROM\n");
@@ -579,26 +769,199 @@ void hw_eeprom_set_ops(struct atheepmgr *aem)
 	}
 }
 
+/**
+ * EEPROM words shadow is a read-through cache of raw (i.e. not swapped) words,
+ * so probing of a data source (magic, eepMisc, build number words), the
+ * following data loading and fallbacks between loaders read each word from
+ * the device only once, and toggling of eep_io_swap does not invalidate it.
+ * Written words are stored to the shadow as well and marked, so they could be
+ * invalidated explicitly to re-read the actually stored content after update.
+ */
+#define EEP_SHADOW_SZ		0x2000	/* Words, covers the biggest EEPROM */
+
+struct eep_shadow {
+	uint16_t data[EEP_SHADOW_SZ];
+	uint32_t valid[EEP_SHADOW_SZ / 32];	/* Word validity bitmap */
+	uint32_t written[EEP_SHADOW_SZ / 32];	/* Words written via shadow */
+	unsigned long dev_reads;		/* Number of device reads */
+};
+
+int hw_eeprom_shadow_init(struct atheepmgr *aem)
+{
+	aem->eep_shadow = calloc(1, sizeof(*aem->eep_shadow));
+	if (!aem->eep_shadow) {
+		fprintf(stderr, "Unable to allocate memory for EEPROM shadow\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void hw_eeprom_shadow_flush(struct atheepmgr *aem)
+{
+	if (aem->eep_shadow) {
+		memset(aem->eep_shadow->valid, 0x00,
+		       sizeof(aem->eep_shadow->valid));
+		memset(aem->eep_shadow->written, 0x00,
+		       sizeof(aem->eep_shadow->written));
+	}
+}
+
+/* Invalidate words, which were written since the last invalidation */
+void hw_eeprom_shadow_invalidate(struct atheepmgr *aem)
+{
+	struct eep_shadow *es = aem->eep_shadow;
+	int i;
+
+	if (!es)
+		return;
+
+	for (i = 0; i < ARRAY_SIZE(es->valid); ++i) {
+		es->valid[i] &= ~es->written[i];
+		es->written[i] = 0;
+	}
+}
+
+unsigned long hw_eeprom_shadow_dev_reads(struct atheepmgr *aem)
+{
+	return aem->eep_shadow ? aem->eep_shadow->dev_reads : 0;
+}
+
+void hw_eeprom_shadow_clean(struct atheepmgr *aem)
+{
+	free(aem->eep_shadow);
+	aem->eep_shadow = NULL;
+}
+
+/**
+ * With registers access bound at build time, call the chip specific reading
+ * routine directly, so the compiler is able to inline it together with the
+ * registers accessors into the caller loop.
+ */
+static inline bool hw_eeprom_read_dev(struct atheepmgr *aem, uint32_t off,
+				      uint16_t *data)
+{
+	if (!hw_is_alive(aem))
+		return false;
+
+#if defined(CONFIG_CON_MMIO_INLINE)
+	if (aem->eep == &hw_eep_9xxx)
+		return hw_eeprom_read_9xxx(aem, off, data);
+	if (aem->eep == &hw_eep_5211)
+		return hw_eeprom_read_5211(aem, off, data);
+#endif
+	return aem->eep->read(aem, off, data);
+}
+
+static bool hw_eeprom_read_shadowed(struct atheepmgr *aem, uint32_t off,
+				    uint16_t *data)
+{
+	struct eep_shadow *es = aem->eep_shadow;
+	uint32_t bit = 1 << (off % 32);
+
+	if (!es || off >= EEP_SHADOW_SZ)
+		return hw_eeprom_read_dev(aem, off, data);
+
+	if (es->valid[off / 32] & bit) {
+		*data = es->data[off];
+		return true;
+	}
+
+	es->dev_reads++;
+	if (!hw_eeprom_read_dev(aem, off, data))
+		return false;
+	es->data[off] = *data;
+	es->valid[off / 32] |= bit;
+
+	return true;
+}
+
 bool hw_eeprom_read(struct atheepmgr *aem, uint32_t off, uint16_t *data)
 {
-	if (!aem->eep || !aem->eep->read(aem, off, data))
+	if (!aem->eep || !hw_eeprom_read_shadowed(aem, off, data)) {
+		PROBE(eep_read, off, 0, 0);
 		return false;
+	}
 
 	if (aem->eep_io_swap)
 		*data = bswap_16(*data);
 
+	PROBE(eep_read, off, *data, 1);
+
 	return true;
 }
 
 bool hw_eeprom_write(struct atheepmgr *aem, uint32_t off, uint16_t data)
 {
+	bool res;
+
 	if (aem->eep_io_swap)
 		data = bswap_16(data);
 
-	if (!aem->eep || !aem->eep->write(aem, off, data))
-		return false;
+	res = aem->eep && hw_is_alive(aem) && aem->eep->write(aem, off, data);
 
-	return true;
+	if (aem->eep_shadow && off < EEP_SHADOW_SZ) {
+		struct eep_shadow *es = aem->eep_shadow;
+		uint32_t bit = 1 << (off % 32);
+
+		if (res) {
+			es->data[off] = data;
+			es->valid[off / 32] |= bit;
+			es->written[off / 32] |= bit;
+		} else {
+			es->valid[off / 32] &= ~bit;	/* Content is unknown */
+		}
+	}
+
+	PROBE(eep_write, off, data, res);
+
+	return res;
+}
+
+#define EEP_PROBE_MIN_SZ	0x40	/* Smallest IC (1 Kbit), words */
+#define EEP_PROBE_SENT_NUM	8	/* Max number of sentinel words */
+
+/**
+ * Detect the actual EEPROM IC size by the address wrap. IC ignores address
+ * bits above its size, so words at a power-of-two boundary of a small IC
+ * repeat the first words. Sentinels are words of the smallest IC, where the
+ * content changes, only they are compared at each boundary, so a few reads
+ * and no writes are needed (the first words are read anyway and come from
+ * the shadow later). Returns size in words or max_len if no wrap is detected,
+ * e.g. if the content is uniform.
+ */
+int hw_eeprom_probe_size(struct atheepmgr *aem, int max_len)
+{
+	uint16_t sent[EEP_PROBE_SENT_NUM], prev = 0, word;
+	int offs[EEP_PROBE_SENT_NUM];
+	int i, num = 0, sz;
+
+	for (i = 0; i < EEP_PROBE_MIN_SZ && num < ARRAY_SIZE(sent); ++i) {
+		if (!EEP_READ(i, &word))
+			return max_len;
+		if (i && word == prev)
+			continue;
+		offs[num] = i;
+		sent[num++] = word;
+		prev = word;
+	}
+	if (num < 2)	/* Wrap is undetectable, e.g. empty EEPROM */
+		return max_len;
+
+	for (sz = EEP_PROBE_MIN_SZ; sz < max_len; sz *= 2) {
+		for (i = 0; i < num; ++i) {
+			if (!EEP_READ(sz + offs[i], &word))
+				return max_len;
+			if (word != sent[i])
+				break;
+		}
+		if (i == num) {
+			TRACE(EEP_SIZE, sz);
+			return sz;
+		}
+	}
+
+	return max_len;
 }
 
 void hw_eeprom_lock(struct atheepmgr *aem, int lock)
@@ -639,12 +1002,28 @@ bool hw_otp_enable(struct atheepmgr *aem, int enable)
 	return aem->otp->enable(aem, enable);
 }
 
+/* Direct call of the chip specific routine, see hw_eeprom_read_dev() */
+static inline bool hw_otp_read_dev(struct atheepmgr *aem, uint32_t off,
+				   uint8_t *data)
+{
+#if defined(CONFIG_CON_MMIO_INLINE)
+	if (aem->otp == &hw_otp_93xx)
+		return hw_otp_read_93xx(aem, off, data);
+	if (aem->otp == &hw_otp_988x)
+		return hw_otp_read_988x(aem, off, data);
+#endif
+	return aem->otp->read(aem, off, data);
+}
+
 bool hw_otp_read(struct atheepmgr *aem, uint32_t off, uint8_t *data)
 {
-	if (!aem->otp)
-		return false;
+	bool res;
 
-	return aem->otp->read(aem, off, data);
+	res = aem->otp && hw_is_alive(aem) && hw_otp_read_dev(aem, off, data);
+
+	PROBE(otp_read, off, res ? *data : 0, res);
+
+	return res;
 }
 
 int hw_init(struct atheepmgr *aem)
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+/**
+ * User-space statically defined tracing (USDT) probes. Each probe is a
+ * single NOP instruction plus an ELF note, so it costs nothing until some
+ * tracer (perf, bpftrace, systemtap) is attached to it, e.g.:
+ *
+ *   bpftrace -e 'usdt:./atheepmgr:atheepmgr:hw_wait { @[arg0] = hist(arg3); }'
+ *
+ * Probes are built only if CONFIG_USDT is enabled, otherwise they are
+ * compiled out completely.
+ *
+ * Available probes and their arguments:
+ *   reg_read(reg, val)
+ *   reg_write(reg, val)
+ *   reg_rmw(reg, set, clr)
+ *   reg_bulk_read(reg, num, by_connector)
+ *   hw_wait(reg, mask, val, iterations, result)
+ *   eep_read(offset, data, result)
+ *   eep_write(offset, data, result)
+ *   otp_read(offset, data, result)
+ *   load_start(source)
+ *   load_done(source, result)
+ */
+
+#if defined(CONFIG_USDT)
+#include <sys/sdt.h>
+
+#define PROBE(__name, ...)						\
+		STAP_PROBEV(atheepmgr, __name, ##__VA_ARGS__)
+#else
+#define PROBE(__name, ...)						\
+		do {} while (0)
+#endif
+
+#endif /* PROBE_H */
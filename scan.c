@@ -0,0 +1,497 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+
+#include "atheepmgr.h"
+#include "eep_common.h"
+#include "eep_5416.h"
+#include "eep_9285.h"
+#include "eep_9287.h"
+#include "eep_9300.h"
+#include "eep_9880.h"
+#include "eep_6174.h"
+#include "eep_9888.h"
+
+/**
+ * Firmware (flash) image scanner, which looks for calibration data at any
+ * 16-bits aligned offset. Image is mapped to memory and scanned in a single
+ * pass: each word is checked against a bitmap of all signature first words
+ * (EEPROM magic, OTP magic, blob lengths) and only the rare hits are passed
+ * to the expensive checksum verification. Large images are split between
+ * several threads, each thread scans its own part and collects results,
+ * which are then printed in the offset order.
+ */
+
+#define SCAN_THREADS_MAX	16
+#define SCAN_PART_MIN		0x100000	/* Do not split smaller parts */
+
+#define SCAN_9300_BLOCKS_MAX	100		/* Same as for the loader */
+#define SCAN_9300_BLOCK_LEN_MAX	1024
+
+static const uint8_t scan_9880_otp_magic[2] = {0xaa, 0x55};
+
+struct scan_res {
+	size_t off;
+	const char *type;
+	bool valid;
+	char info[48];
+};
+
+struct scan_part {
+	pthread_t thread;
+	const uint8_t *img;
+	size_t img_sz;
+	size_t start;		/* Part first offset */
+	size_t end;		/* Part end (exclusive) */
+	bool verbose;		/* Collect rejected candidates too */
+	struct scan_res *res;
+	size_t nres;
+	size_t res_sz;
+	int err;
+};
+
+/* Bitmap of 16-bits words, which could begin some signature */
+static uint8_t scan_sigmap[0x10000 / 8];
+
+static const struct {
+	const char *name;
+	uint16_t start;		/* Data start location, words */
+	uint16_t size;		/* Data size, words */
+} scan_5416_maps[] = {
+	{"5416", AR5416_DATA_START_LOC, AR5416_DATA_SZ},
+	{"9287", AR9287_DATA_START_LOC, AR9287_DATA_SZ},
+	{"9285", AR9285_DATA_START_LOC, AR9285_DATA_SZ},
+};
+
+static const struct {
+	const char *name;
+	uint16_t size;		/* Blob size, bytes */
+} scan_blobs[] = {
+	{"9880", sizeof(struct qca9880_eeprom)},
+	{"6174", sizeof(struct qca6174_eeprom)},
+	{"9888", sizeof(struct qca9888_eeprom)},
+};
+
+static const uint16_t scan_9300_bases[] = {
+	AR9300_BASE_ADDR, AR9300_BASE_ADDR_4K, AR9300_BASE_ADDR_512,
+};
+
+static inline uint16_t scan_word(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static void scan_sigmap_add(uint16_t word)
+{
+	scan_sigmap[word / 8] |= 1 << (word % 8);
+	word = bswap_16(word);
+	scan_sigmap[word / 8] |= 1 << (word % 8);
+}
+
+static void scan_sigmap_init(void)
+{
+	int i;
+
+	scan_sigmap_add(0xa55a);	/* AR5416 family & AR9300 EEPROM magic */
+	scan_sigmap_add(scan_word(scan_9880_otp_magic));
+	for (i = 0; i < ARRAY_SIZE(scan_blobs); ++i)
+		scan_sigmap_add(scan_blobs[i].size);
+}
+
+static void scan_add(struct scan_part *part, size_t off, const char *type,
+		     bool valid, const char *fmt, ...)
+{
+	struct scan_res *res;
+	va_list ap;
+
+	if (!valid && !part->verbose)
+		return;
+
+	if (part->nres == part->res_sz) {
+		size_t sz = part->res_sz ? part->res_sz * 2 : 16;
+
+		res = realloc(part->res, sz * sizeof(*res));
+		if (!res) {
+			part->err = -ENOMEM;
+			return;
+		}
+		part->res = res;
+		part->res_sz = sz;
+	}
+
+	res = &part->res[part->nres++];
+	res->off = off;
+	res->type = type;
+	res->valid = valid;
+	va_start(ap, fmt);
+	vsnprintf(res->info, sizeof(res->info), fmt, ap);
+	va_end(ap);
+}
+
+/* Returns true if the candidate was recognized as an AR5416 family data */
+static bool scan_5416(struct scan_part *part, size_t off)
+{
+	const uint8_t *p = part->img + off;
+	size_t avail = (part->img_sz - off) / 2;
+	bool swap = scan_word(p) != 0xa55a;
+	uint16_t len, sum;
+	int i, el;
+
+	for (i = 0; i < ARRAY_SIZE(scan_5416_maps); ++i) {
+		if (avail < scan_5416_maps[i].start + scan_5416_maps[i].size)
+			continue;
+		len = scan_word(p + scan_5416_maps[i].start * 2);
+		if (swap)
+			len = bswap_16(len);
+		el = len / sizeof(uint16_t);
+		if (el < 2 || el > scan_5416_maps[i].size)
+			continue;
+		/* XOR checksum does not depend on the words byte order */
+		sum = eep_calc_csum((const uint16_t *)(p +
+					scan_5416_maps[i].start * 2), el);
+		if (sum != 0xffff)
+			continue;
+		scan_add(part, off, scan_5416_maps[i].name, true,
+			 "length 0x%04x%s", len, swap ? ", byteswapped" : "");
+		return true;
+	}
+
+	return false;
+}
+
+/* Checks the compressed block structure the same way as the unpacker does */
+static bool scan_9300_block_ok(const uint8_t *in, int in_len)
+{
+	const int out_size = sizeof(struct ar9300_eeprom);
+	int it, spot = 0, length;
+
+	for (it = 0; it < in_len; it += length + 2) {
+		if (it + 2 > in_len)
+			return false;
+		spot += in[it];
+		length = in[it + 1];
+		if (it + 2 + length > in_len)
+			return false;
+		if (length > 0 && spot + length > out_size)
+			return false;
+		spot += length;
+	}
+
+	return true;
+}
+
+/**
+ * Walk the AR9300 compressed blocks chain, which starts at the <base> offset
+ * of EEPROM data and grows down. Returns a number of valid blocks.
+ */
+static int scan_9300_chain(const uint8_t *p, size_t avail, bool swap,
+			   int base)
+{
+	uint8_t buf[AR9300_COMP_HDR_LEN + 0x800 + AR9300_COMP_CKSUM_LEN];
+	struct ar9300_comp_hdr hdr;
+	int cptr = base, blocks = 0;
+	uint16_t cksum, mcksum;
+	int it, i, n;
+
+	if (base >= avail)
+		return 0;
+
+	for (it = 0; it < SCAN_9300_BLOCKS_MAX; ++it) {
+		if (cptr < AR9300_COMP_HDR_LEN)
+			break;
+		/* Extract byte stream in the reverse direction */
+		n = cptr + 1 < sizeof(buf) ? cptr + 1 : sizeof(buf);
+		for (i = 0; i < n; ++i)
+			buf[i] = p[(cptr - i) ^ swap];
+
+		if (!ar9300_check_header(buf))
+			break;
+		ar9300_comp_hdr_unpack(buf, &hdr);
+		if (hdr.len >= SCAN_9300_BLOCK_LEN_MAX ||
+		    AR9300_COMP_HDR_LEN + hdr.len + AR9300_COMP_CKSUM_LEN > cptr) {
+			cptr -= AR9300_COMP_HDR_LEN;
+			continue;
+		}
+
+		cksum = ar9300_comp_cksum(buf + AR9300_COMP_HDR_LEN, hdr.len);
+		mcksum = scan_word(buf + AR9300_COMP_HDR_LEN + hdr.len);
+		if (cksum != mcksum) {
+			cptr -= AR9300_COMP_HDR_LEN;
+			continue;
+		}
+
+		if ((hdr.comp == AR9300_COMP_NONE &&
+		     hdr.len == sizeof(struct ar9300_eeprom)) ||
+		    (hdr.comp == AR9300_COMP_BLOCK &&
+		     scan_9300_block_ok(buf + AR9300_COMP_HDR_LEN, hdr.len)))
+			blocks++;
+
+		cptr -= AR9300_COMP_HDR_LEN + hdr.len + AR9300_COMP_CKSUM_LEN;
+	}
+
+	return blocks;
+}
+
+static bool scan_9300(struct scan_part *part, size_t off)
+{
+	const uint8_t *p = part->img + off;
+	size_t avail = part->img_sz - off;
+	bool swap = scan_word(p) != 0xa55a;
+	int i, blocks;
+
+	for (i = 0; i < ARRAY_SIZE(scan_9300_bases); ++i) {
+		blocks = scan_9300_chain(p, avail, swap, scan_9300_bases[i]);
+		if (!blocks)
+			continue;
+		scan_add(part, off, "9300", true,
+			 "%d block(s) at 0x%04x%s", blocks, scan_9300_bases[i],
+			 swap ? ", byteswapped" : "");
+		return true;
+	}
+
+	return false;
+}
+
+/* Check OTP streams and look for a valid calibration data block */
+static bool scan_9880_otp(struct scan_part *part, size_t off)
+{
+	const uint8_t *buf = part->img + off - QCA9880_OTP_MAGIC_OFFSET;
+	const uint8_t *p, *s = NULL, *data;
+	uint8_t strcode = 0xff, end_mark_seen = 0;
+	struct ar9300_comp_hdr hdr;
+	int len;
+
+	for (p = buf + QCA9880_OTP_HEADER_SIZE;
+	     p < buf + QCA9880_OTP_MAGIC_OFFSET; ++p) {
+		if (strcode == 0xff) {		/* Not inside OTP stream */
+			if (*p == 0x00 || !QCA9880_OTP_STR_MARK_IS_BEGIN(*p))
+				break;
+			strcode = QCA9880_OTP_STR_MARK_CODE(*p);
+			end_mark_seen = 0;
+			s = p;
+		} else if (!QCA9880_OTP_STR_MARK_IS_END(*p) ||
+			   strcode != QCA9880_OTP_STR_MARK_CODE(*p)) {
+			end_mark_seen = 0;
+		} else if (!end_mark_seen) {
+			end_mark_seen = 1;
+		} else {
+			const struct qca9880_otp_str *str = (void *)(s + 1);
+
+			strcode = 0xff;
+			len = p - s - 2 - sizeof(*str);
+			if (len < 0 || str->type != QCA9880_OTP_STR_TYPE_CALDATA)
+				continue;
+
+			data = str->data;
+			ar9300_comp_hdr_unpack(data, &hdr);
+			data += AR9300_COMP_HDR_LEN;
+			len -= AR9300_COMP_HDR_LEN + AR9300_COMP_CKSUM_LEN;
+			if (hdr.len > len)
+				continue;
+			if (ar9300_comp_cksum(data, hdr.len) !=
+			    scan_word(data + hdr.len))
+				continue;
+
+			scan_add(part, off - QCA9880_OTP_MAGIC_OFFSET,
+				 "9880 OTP", true, "caldata block at 0x%04x",
+				 (unsigned int)(s - buf));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool scan_blob(struct scan_part *part, size_t off, uint16_t word)
+{
+	const uint8_t *p = part->img + off;
+	uint16_t sum;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(scan_blobs); ++i) {
+		if (word != scan_blobs[i].size &&
+		    bswap_16(word) != scan_blobs[i].size)
+			continue;
+		if (part->img_sz - off < scan_blobs[i].size)
+			continue;
+		sum = eep_calc_csum((const uint16_t *)p,
+				    scan_blobs[i].size / sizeof(uint16_t));
+		if (sum != 0xffff)
+			continue;
+		scan_add(part, off, scan_blobs[i].name, true,
+			 "length 0x%04x%s", scan_blobs[i].size,
+			 word != scan_blobs[i].size ? ", byteswapped" : "");
+		return true;
+	}
+
+	return false;
+}
+
+static void *scan_thread(void *arg)
+{
+	struct scan_part *part = arg;
+	const uint8_t *img = part->img;
+	uint16_t word;
+	size_t off;
+
+	for (off = part->start; off < part->end; off += 2) {
+		word = scan_word(img + off);
+		if (!(scan_sigmap[word / 8] & (1 << (word % 8))))
+			continue;	/* Fast path, no signature begins here */
+
+		if (word == 0xa55a || word == 0x5aa5) {
+			if (!scan_5416(part, off) && !scan_9300(part, off))
+				scan_add(part, off, "EEPROM magic", false,
+					 "no valid data found");
+		} else if (memcmp(img + off, scan_9880_otp_magic,
+				  sizeof(scan_9880_otp_magic)) == 0) {
+			if (off >= QCA9880_OTP_MAGIC_OFFSET &&
+			    !scan_9880_otp(part, off))
+				scan_add(part, off - QCA9880_OTP_MAGIC_OFFSET,
+					 "9880 OTP", false,
+					 "no valid caldata stream");
+		} else {
+			scan_blob(part, off, word);
+		}
+	}
+
+	return NULL;
+}
+
+int scan_run(struct atheepmgr *aem, int argc, char *argv[])
+{
+	struct scan_part parts[SCAN_THREADS_MAX];
+	unsigned long nthreads;
+	size_t img_sz, part_sz, i, j, nvalid = 0;
+	const struct scan_res *res;
+	struct stat st;
+	uint8_t *img;
+	char *endp;
+	int fd, ret = 0;
+
+	if (argc < 1) {
+		fprintf(stderr, "Image file is not specified, aborting\n");
+		return -EINVAL;
+	}
+
+	if (argc > 1) {
+		errno = 0;
+		nthreads = strtoul(argv[1], &endp, 10);
+		if (errno || *endp != '\0' || !nthreads ||
+		    nthreads > SCAN_THREADS_MAX) {
+			fprintf(stderr, "Invalid threads number -- %s (should be 1..%d)\n",
+				argv[1], SCAN_THREADS_MAX);
+			return -EINVAL;
+		}
+	} else {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+		nthreads = ncpu < 1 ? 1 : ncpu > SCAN_THREADS_MAX ?
+			   SCAN_THREADS_MAX : ncpu;
+	}
+
+	fd = open(argv[0], O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to open image file %s: %s\n", argv[0],
+			strerror(errno));
+		return -errno;
+	}
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "Unable to stat image file %s: %s\n", argv[0],
+			strerror(errno));
+		ret = -errno;
+		goto exit_close;
+	}
+	img_sz = st.st_size & ~(size_t)1;
+	if (!img_sz) {
+		fprintf(stderr, "Image file %s is empty\n", argv[0]);
+		ret = -EINVAL;
+		goto exit_close;
+	}
+
+	img = mmap(NULL, img_sz, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (img == MAP_FAILED) {
+		fprintf(stderr, "Unable to map image file %s: %s\n", argv[0],
+			strerror(errno));
+		ret = -errno;
+		goto exit_close;
+	}
+	madvise(img, img_sz, MADV_SEQUENTIAL);
+
+	scan_sigmap_init();
+
+	/* Split image to 16-bits aligned parts, but avoid too small ones */
+	if (img_sz / nthreads < SCAN_PART_MIN)
+		nthreads = img_sz / SCAN_PART_MIN ? img_sz / SCAN_PART_MIN : 1;
+	part_sz = (img_sz / nthreads + 1) & ~(size_t)1;
+
+	if (aem->verbose)
+		printf("Scan 0x%zx bytes with %lu thread(s)\n", img_sz,
+		       nthreads);
+
+	memset(parts, 0x00, sizeof(parts));
+	for (i = 0; i < nthreads; ++i) {
+		parts[i].img = img;
+		parts[i].img_sz = img_sz;
+		parts[i].start = i * part_sz;
+		parts[i].end = i == nthreads - 1 ? img_sz :
+			       (i + 1) * part_sz;
+		parts[i].verbose = aem->verbose;
+		if (i == 0)	/* Scan the first part in the main thread */
+			continue;
+		if (pthread_create(&parts[i].thread, NULL, scan_thread,
+				   &parts[i]) != 0) {
+			/* Scan this part in the main thread later */
+			parts[i].thread = pthread_self();
+		}
+	}
+	scan_thread(&parts[0]);
+	for (i = 1; i < nthreads; ++i) {
+		if (pthread_equal(parts[i].thread, pthread_self()))
+			scan_thread(&parts[i]);
+		else
+			pthread_join(parts[i].thread, NULL);
+	}
+
+	for (i = 0; i < nthreads; ++i) {
+		if (parts[i].err)
+			ret = parts[i].err;
+		for (j = 0; j < parts[i].nres; ++j) {
+			res = &parts[i].res[j];
+			printf("0x%08zx: %-12s %-7s %s\n", res->off, res->type,
+			       res->valid ? "valid" : "invalid", res->info);
+			if (res->valid)
+				nvalid++;
+		}
+		free(parts[i].res);
+	}
+	printf("Found %zu calibration data candidate(s)\n", nvalid);
+	if (ret)
+		fprintf(stderr, "Some scan results are lost due to the lack of memory\n");
+
+	munmap(img, img_sz);
+
+exit_close:
+	close(fd);
+
+	return ret;
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <signal.h>
+
+#include "atheepmgr.h"
+#include "utils.h"
+
+/**
+ * Requests server, which listens on a Unix stream socket and serves clients
+ * one by one. Each request is a single text line with a command and its
+ * arguments separated by whitespace, exactly like the command line action.
+ * Command output (both stdout and stderr) is passed to the client as-is and
+ * terminated by the "END <code>" line, where <code> is the command result.
+ *
+ * Server handles only two commands by itself: 'quit' closes the client
+ * connection and 'shutdown' stops the server. Everything else is passed to
+ * the request handler.
+ */
+
+static volatile sig_atomic_t server_stop;
+
+static void server_sighandler(int signum)
+{
+	server_stop = 1;
+}
+
+static int server_request(struct atheepmgr *aem, int fd, int argc,
+			  char *argv[], server_req_handler_t handler)
+{
+	int saved_out, saved_err;
+	int ret;
+
+	fflush(stdout);
+	fflush(stderr);
+	saved_out = dup(STDOUT_FILENO);
+	saved_err = dup(STDERR_FILENO);
+	if (saved_out < 0 || saved_err < 0) {
+		fprintf(stderr, "Unable to save output descriptors: %s\n",
+			strerror(errno));
+		ret = -errno;
+		goto exit;
+	}
+	dup2(fd, STDOUT_FILENO);
+	dup2(fd, STDERR_FILENO);
+
+	ret = handler(aem, argc, argv);
+
+	fflush(stdout);
+	fflush(stderr);
+	dup2(saved_out, STDOUT_FILENO);
+	dup2(saved_err, STDERR_FILENO);
+
+exit:
+	if (saved_out >= 0)
+		close(saved_out);
+	if (saved_err >= 0)
+		close(saved_err);
+
+	return ret;
+}
+
+/* Returns true if server should be stopped */
+static bool server_client(struct atheepmgr *aem, int fd,
+			  server_req_handler_t handler)
+{
+	char *argv[SESSION_ARGS_MAX];
+	char *line = NULL;
+	size_t linesz = 0;
+	bool stop = false;
+	FILE *in;
+	int argc, ret;
+
+	in = fdopen(dup(fd), "r");
+	if (!in) {
+		fprintf(stderr, "Unable to open client stream: %s\n",
+			strerror(errno));
+		return false;
+	}
+
+	while (!server_stop && getline(&line, &linesz, in) != -1) {
+		argc = str_split(line, argv, ARRAY_SIZE(argv));
+		if (argc < 0) {
+			dprintf(fd, "Too many request arguments, max is %d\n",
+				SESSION_ARGS_MAX - 1);
+			dprintf(fd, "END %d\n", argc);
+			continue;
+		}
+		if (!argc)
+			continue;
+		if (strcmp(argv[0], "quit") == 0)
+			break;
+		if (strcmp(argv[0], "shutdown") == 0) {
+			stop = true;
+			break;
+		}
+
+		if (aem->verbose)
+			printf("Serve request: %s\n", argv[0]);
+		ret = server_request(aem, fd, argc, argv, handler);
+		dprintf(fd, "END %d\n", ret);
+	}
+
+	free(line);
+	fclose(in);
+
+	return stop;
+}
+
+/**
+ * Create a listening Unix socket, which is accessible by the owner only, since
+ * clients are able to modify the card and write files on behalf of the
+ * (usually privileged) process. Returns socket descriptor or negative errno.
+ */
+int server_listen(const char *path, int backlog)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	mode_t omask;
+	int fd, ret;
+
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path is too long -- %s\n", path);
+		return -EINVAL;
+	}
+	strcpy(addr.sun_path, path);
+
+	/* Remove a stale socket if any, but nothing else */
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			fprintf(stderr, "Refuse to replace %s, which is not a socket\n",
+				path);
+			return -EEXIST;
+		}
+		unlink(path);
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to create socket: %s\n",
+			strerror(errno));
+		return -errno;
+	}
+
+	omask = umask(0177);	/* Socket mode is 0600 */
+	ret = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	umask(omask);
+	if (ret != 0 || listen(fd, backlog) != 0) {
+		fprintf(stderr, "Unable to listen on %s: %s\n", path,
+			strerror(errno));
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	return fd;
+}
+
+int server_run(struct atheepmgr *aem, const char *path,
+	       server_req_handler_t handler)
+{
+	struct sigaction sa;
+	int fd, cfd;
+	int ret;
+
+	fd = server_listen(path, 4);
+	if (fd < 0)
+		return fd;
+
+	/* No SA_RESTART, so signals are able to interrupt accept() */
+	memset(&sa, 0x00, sizeof(sa));
+	sa.sa_handler = server_sighandler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	if (aem->verbose)
+		printf("Serve requests on %s\n", path);
+
+	ret = 0;
+	while (!server_stop) {
+		cfd = accept(fd, NULL, NULL);
+		if (cfd < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Unable to accept connection: %s\n",
+				strerror(errno));
+			ret = -errno;
+			break;
+		}
+		if (server_client(aem, cfd, handler))
+			server_stop = 1;
+		close(cfd);
+	}
+
+	unlink(path);
+	close(fd);
+
+	return ret;
+}
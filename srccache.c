@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "atheepmgr.h"
+
+/**
+ * Data source cache is a text file, which remembers per device the data
+ * source (EEPROM, OTP, etc.) and the data base address, which succeeded last
+ * time, so the next run tries them first and does not pay for probing of
+ * absent sources. Each line is a device key followed by a source name and
+ * a base address. The key consists of the connector name and argument (e.g.
+ * PCI slot), the EEPROM map name and the chip SREV.
+ */
+
+#define SRCCACHE_LINE_MAX	256
+
+struct srccache {
+	char *path;
+	char key[SRCCACHE_LINE_MAX];
+	int src;		/* Cached source or -1 */
+	int base;
+	bool dirty;
+};
+
+static void srccache_key_build(struct atheepmgr *aem, struct srccache *sc,
+			       const char *con_arg)
+{
+	char *p;
+
+	snprintf(sc->key, sizeof(sc->key), "%s:%s:%s:%04x.%02x",
+		 aem->con->name, con_arg ? con_arg : "",
+		 aem->eepmap->name, aem->macVersion, aem->macRev);
+	for (p = sc->key; *p; ++p)	/* Key is a single word */
+		if (*p == ' ' || *p == '\t')
+			*p = '_';
+}
+
+static int srccache_src_parse(const char *name)
+{
+	int i;
+
+	for (i = TRACE_SRC_BLOB; i <= TRACE_SRC_OTP; ++i)
+		if (strcmp(trace_src_names[i], name) == 0)
+			return i;
+
+	return -1;
+}
+
+int srccache_open(struct atheepmgr *aem, const char *path,
+		  const char *con_arg)
+{
+	char line[SRCCACHE_LINE_MAX], key[SRCCACHE_LINE_MAX], src[16];
+	struct srccache *sc;
+	unsigned int base;
+	FILE *fp;
+
+	sc = calloc(1, sizeof(*sc));
+	if (sc)
+		sc->path = strdup(path);
+	if (!sc || !sc->path) {
+		fprintf(stderr, "srccache: unable to allocate memory\n");
+		free(sc);
+		return -ENOMEM;
+	}
+	sc->src = -1;
+	srccache_key_build(aem, sc, con_arg);
+	aem->srccache = sc;
+
+	/* Cache only speeds up loading, so its errors are not fatal */
+	fp = fopen(path, "r");
+	if (!fp) {
+		if (errno != ENOENT)	/* Will be created on success */
+			fprintf(stderr, "srccache: can not open '%s', ignore it: %s\n",
+				path, strerror(errno));
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%255s %15s %x", key, src, &base) != 3 ||
+		    strcmp(key, sc->key) != 0)
+			continue;
+		sc->src = srccache_src_parse(src);
+		sc->base = base;
+	}
+
+	if (ferror(fp)) {
+		fprintf(stderr, "srccache: can not read '%s', ignore it: %s\n",
+			path, strerror(errno));
+		sc->src = -1;
+	}
+
+	fclose(fp);
+
+	if (aem->verbose && sc->src >= 0)
+		printf("srccache: last time data were loaded from %s at 0x%04x\n",
+		       trace_src_names[sc->src], sc->base);
+
+	return 0;
+}
+
+/* Get the source, which succeeded last time, returns -1 if unknown */
+int srccache_get(struct atheepmgr *aem, int *base)
+{
+	struct srccache *sc = aem->srccache;
+
+	if (!sc || sc->src < 0)
+		return -1;
+
+	*base = sc->base;
+
+	return sc->src;
+}
+
+void srccache_put(struct atheepmgr *aem, int src, int base)
+{
+	struct srccache *sc = aem->srccache;
+
+	if (!sc || (sc->src == src && sc->base == base))
+		return;
+
+	sc->src = src;
+	sc->base = base;
+	sc->dirty = true;
+}
+
+/* Rewrite the cache file with the updated entry of the device */
+static void srccache_flush(struct srccache *sc)
+{
+	char line[SRCCACHE_LINE_MAX], key[SRCCACHE_LINE_MAX], *tmp;
+	FILE *fp, *ofp;
+
+	tmp = malloc(strlen(sc->path) + sizeof(".tmp"));
+	if (!tmp) {
+		fprintf(stderr, "srccache: unable to allocate memory\n");
+		return;
+	}
+	sprintf(tmp, "%s.tmp", sc->path);
+
+	ofp = fopen(tmp, "w");
+	if (!ofp) {
+		fprintf(stderr, "srccache: can not create '%s': %s\n", tmp,
+			strerror(errno));
+		free(tmp);
+		return;
+	}
+
+	fp = fopen(sc->path, "r");
+	while (fp && fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%255s", key) == 1 &&
+		    strcmp(key, sc->key) == 0)
+			continue;	/* Outdated entry */
+		fputs(line, ofp);
+	}
+	if (fp)
+		fclose(fp);
+
+	fprintf(ofp, "%s %s 0x%04x\n", sc->key, trace_src_names[sc->src],
+		sc->base);
+
+	if (fclose(ofp) != 0 || rename(tmp, sc->path) != 0) {
+		fprintf(stderr, "srccache: unable to update '%s': %s\n",
+			sc->path, strerror(errno));
+		unlink(tmp);
+	}
+
+	free(tmp);
+}
+
+void srccache_close(struct atheepmgr *aem)
+{
+	struct srccache *sc = aem->srccache;
+
+	if (!sc)
+		return;
+
+	if (sc->dirty)
+		srccache_flush(sc);
+
+	free(sc->path);
+	free(sc);
+	aem->srccache = NULL;
+}
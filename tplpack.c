@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#include "atheepmgr.h"
+
+/**
+ * Template pack is a file with a set of external EEPROM data templates. Pack
+ * begins with a fixed header that is followed by an index of templates. Each
+ * index entry points to the template data somewhere in the file. All numbers
+ * are Little-endian.
+ *
+ * Pack is mapped to the process memory as-is, only the index is parsed on
+ * opening, so template data will be paged in only when a compressed block
+ * really references a template.
+ */
+
+#define TPLPACK_MAGIC		"AEMTPLPK"
+#define TPLPACK_VERSION		1
+
+struct tplpack_hdr {
+	char magic[8];		/* Should be equal to TPLPACK_MAGIC */
+	uint32_t version;	/* Pack format version */
+	uint32_t num;		/* Number of index entries */
+} __attribute__ ((packed));
+
+struct tplpack_idx {
+	char eepmap[8];		/* EEPROM map name, NUL padded */
+	uint32_t id;		/* Templ. id as specified in the comp. header */
+	uint32_t offset;	/* Template data offset from the pack start */
+	uint32_t len;		/* Template data length */
+	char name[20];		/* Template name for user, NUL padded */
+} __attribute__ ((packed));
+
+struct tplpack_tpl {
+	char eepmap[sizeof(((struct tplpack_idx *)0)->eepmap) + 1];
+	char name[sizeof(((struct tplpack_idx *)0)->name) + 1];
+	size_t len;
+	struct eeptemplate tpl;
+};
+
+struct tplpack {
+	void *map;
+	size_t map_sz;
+	unsigned int num;
+	struct tplpack_tpl tpls[];
+};
+
+int tplpack_open(struct atheepmgr *aem, const char *fname)
+{
+	const struct tplpack_hdr *hdr;
+	const struct tplpack_idx *idx;
+	struct tplpack *tp = NULL;
+	struct stat st;
+	void *map = MAP_FAILED;
+	unsigned int i, num;
+	int fd, err;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "tplpack: can not open template pack '%s': %s\n",
+			fname, strerror(errno));
+		return -errno;
+	}
+
+	if (fstat(fd, &st) != 0) {
+		err = -errno;
+		fprintf(stderr, "tplpack: can not stat template pack: %s\n",
+			strerror(errno));
+		goto err;
+	}
+	if (st.st_size < sizeof(*hdr)) {
+		fprintf(stderr, "tplpack: template pack '%s' is too short\n",
+			fname);
+		err = -EINVAL;
+		goto err;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		err = -errno;
+		fprintf(stderr, "tplpack: can not map template pack: %s\n",
+			strerror(errno));
+		goto err;
+	}
+
+	hdr = map;
+	if (memcmp(hdr->magic, TPLPACK_MAGIC, sizeof(hdr->magic)) != 0 ||
+	    le32toh(hdr->version) != TPLPACK_VERSION) {
+		fprintf(stderr, "tplpack: '%s' is not a template pack or has unsupported version\n",
+			fname);
+		err = -EINVAL;
+		goto err;
+	}
+
+	num = le32toh(hdr->num);
+	if (num > (st.st_size - sizeof(*hdr)) / sizeof(*idx)) {
+		fprintf(stderr, "tplpack: index of %u entries does not fit the pack\n",
+			num);
+		err = -EINVAL;
+		goto err;
+	}
+
+	tp = malloc(sizeof(*tp) + num * sizeof(tp->tpls[0]));
+	if (!tp) {
+		fprintf(stderr, "tplpack: unable to allocate memory for the templates index\n");
+		err = -ENOMEM;
+		goto err;
+	}
+
+	idx = (const void *)(hdr + 1);
+	for (i = 0; i < num; ++i, ++idx) {
+		struct tplpack_tpl *t = &tp->tpls[i];
+		uint32_t off = le32toh(idx->offset);
+		uint32_t len = le32toh(idx->len);
+
+		if (off > st.st_size || len > st.st_size - off) {
+			fprintf(stderr, "tplpack: template #%u data points outside the pack\n",
+				i);
+			err = -EINVAL;
+			goto err;
+		}
+
+		memcpy(t->eepmap, idx->eepmap, sizeof(idx->eepmap));
+		t->eepmap[sizeof(idx->eepmap)] = '\0';
+		memcpy(t->name, idx->name, sizeof(idx->name));
+		t->name[sizeof(idx->name)] = '\0';
+		t->len = len;
+		t->tpl.id = le32toh(idx->id);
+		t->tpl.name = t->name;
+		t->tpl.data = (const uint8_t *)map + off;
+	}
+
+	close(fd);
+
+	tp->map = map;
+	tp->map_sz = st.st_size;
+	tp->num = num;
+	aem->tplpack = tp;
+
+	if (aem->verbose)
+		printf("tplpack: loaded index of %u template(s) from %s\n",
+		       num, fname);
+
+	return 0;
+
+err:
+	free(tp);
+	if (map != MAP_FAILED)
+		munmap(map, st.st_size);
+	close(fd);
+
+	return err;
+}
+
+void tplpack_close(struct atheepmgr *aem)
+{
+	struct tplpack *tp = aem->tplpack;
+
+	if (!tp)
+		return;
+
+	munmap(tp->map, tp->map_sz);
+	free(tp);
+	aem->tplpack = NULL;
+}
+
+/**
+ * Search a template for specified EEPROM map by Id or by name (if name is not
+ * NULL). Templates with data length that mismatch the EEPROM map unpacked data
+ * size are silently skipped.
+ */
+const struct eeptemplate *tplpack_lookup(struct atheepmgr *aem,
+					 const struct eepmap *eepmap,
+					 int id, const char *name)
+{
+	struct tplpack *tp = aem->tplpack;
+	unsigned int i;
+
+	if (!tp || !eepmap)
+		return NULL;
+
+	for (i = 0; i < tp->num; ++i) {
+		const struct tplpack_tpl *t = &tp->tpls[i];
+
+		if (strcasecmp(t->eepmap, eepmap->name) != 0)
+			continue;
+		if (t->len != eepmap->unpacked_buf_sz)
+			continue;
+		if (t->tpl.id == id || (name && strcasecmp(t->name, name) == 0))
+			return &t->tpl;
+	}
+
+	return NULL;
+}
+
+/**
+ * Get n-th template of the specified EEPROM map, used to iterate over the
+ * applicable templates.
+ */
+const struct eeptemplate *tplpack_nth(struct atheepmgr *aem,
+				      const struct eepmap *eepmap, int n)
+{
+	struct tplpack *tp = aem->tplpack;
+	unsigned int i;
+
+	if (!tp)
+		return NULL;
+
+	for (i = 0; i < tp->num; ++i) {
+		const struct tplpack_tpl *t = &tp->tpls[i];
+
+		if (strcasecmp(t->eepmap, eepmap->name) != 0 ||
+		    t->len != eepmap->unpacked_buf_sz)
+			continue;
+		if (n-- == 0)
+			return &t->tpl;
+	}
+
+	return NULL;
+}
+
+void tplpack_list(struct atheepmgr *aem, const struct eepmap *eepmap)
+{
+	struct tplpack *tp = aem->tplpack;
+	unsigned int i;
+
+	if (!tp)
+		return;
+
+	for (i = 0; i < tp->num; ++i) {
+		const struct tplpack_tpl *t = &tp->tpls[i];
+
+		if (strcasecmp(t->eepmap, eepmap->name) != 0 ||
+		    t->len != eepmap->unpacked_buf_sz)
+			continue;
+		printf("%20s%d: %s (external)\n", "", t->tpl.id, t->name);
+	}
+}
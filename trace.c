@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include "atheepmgr.h"
+
+struct trace_ent trace_ring[TRACE_RING_SZ];
+unsigned int trace_head;
+
+static unsigned int trace_mark_pos;	/* Start of the current dump window */
+
+const char * const trace_src_names[] = {
+	[TRACE_SRC_RAW_EEPROM] = "raw-eeprom",
+	[TRACE_SRC_RAW_OTP] = "raw-otp",
+	[TRACE_SRC_BLOB] = "blob",
+	[TRACE_SRC_EEPROM] = "eeprom",
+	[TRACE_SRC_OTP] = "otp",
+};
+
+static const char *trace_src_name(uint32_t src)
+{
+	if (src >= ARRAY_SIZE(trace_src_names))
+		return "<unknown>";
+
+	return trace_src_names[src];
+}
+
+static void trace_ent_print(FILE *fp, const struct trace_ent *ent)
+{
+	const uint32_t *a = ent->arg;
+
+	switch (ent->ev) {
+	case TRACE_EV_LOAD_START:
+		fprintf(fp, "Try to load data from %s\n", trace_src_name(a[0]));
+		break;
+	case TRACE_EV_LOAD_DONE:
+		fprintf(fp, "Loading from %s %s\n", trace_src_name(a[0]),
+			a[1] ? "succeeded" : "failed");
+		break;
+	case TRACE_EV_RAW_READ:
+		fprintf(fp, "RAW %s read [0x0000...0x%04x]\n",
+			trace_src_name(a[0]), a[1] - 1);
+		break;
+	case TRACE_EV_EEP_MAGIC:
+		fprintf(fp, "EEPROM magic found%s\n",
+			a[0] ? ", use byteswapped EEPROM I/O" : "");
+		break;
+	case TRACE_EV_EEP_SIZE:
+		fprintf(fp, "EEPROM address wraps at 0x%04x words (%u bytes IC)\n",
+			a[0], a[0] * 2);
+		break;
+	case TRACE_EV_9300_ACCESS:
+		fprintf(fp, "Trying %s access at Address 0x%04x\n",
+			trace_src_name(a[0]), a[1]);
+		break;
+	case TRACE_EV_9300_BLOCK:
+		fprintf(fp, "Found block at %x: comp=%u ref=%u length=%u major=%u minor=%u\n",
+			a[0], a[1], a[2], a[3] & 0xfff, (a[3] >> 12) & 0xf,
+			a[3] >> 16);
+		break;
+	case TRACE_EV_9300_BAD_LEN:
+		fprintf(fp, "Skipping block at %x with bad length %u\n", a[0],
+			a[1]);
+		break;
+	case TRACE_EV_9300_BAD_CSUM:
+		fprintf(fp, "Skipping block at %x with bad checksum (got 0x%04x, expect 0x%04x)\n",
+			a[0], a[1], a[2]);
+		break;
+	case TRACE_EV_9300_RESTORE_NONE:
+		fprintf(fp, "Restored eeprom %u: uncompressed, length %u\n",
+			a[0], a[1]);
+		break;
+	case TRACE_EV_9300_RESTORE_BLOCK:
+		fprintf(fp, "Restore eeprom %u: block, reference %u, length %u\n",
+			a[0], a[1], a[2]);
+		break;
+	case TRACE_EV_9300_RESTORE_RUN:
+		fprintf(fp, "Restore at %u: spot=%u offset=%u length=%u\n",
+			a[0], a[1], a[2], a[3]);
+		break;
+	default:
+		fprintf(fp, "Unknown event %u: %08x %08x %08x %08x\n", ent->ev,
+			a[0], a[1], a[2], a[3]);
+	}
+}
+
+/* Start a new window, e.g. before data loading */
+void trace_mark(void)
+{
+	trace_mark_pos = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+}
+
+/* Dump events of the current window or all retained events */
+void trace_dump(FILE *fp, bool all)
+{
+	unsigned int head = __atomic_load_n(&trace_head, __ATOMIC_RELAXED);
+	unsigned int pos = all ? 0 : trace_mark_pos;
+
+	if (head - pos > TRACE_RING_SZ) {
+		fprintf(fp, "(%u earlier trace events were overwritten)\n",
+			head - pos - TRACE_RING_SZ);
+		pos = head - TRACE_RING_SZ;
+	}
+
+	for (; pos != head; ++pos)
+		trace_ent_print(fp, &trace_ring[pos & (TRACE_RING_SZ - 1)]);
+}
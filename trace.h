@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * In-memory trace ring. Hot paths (data loaders, AR93xx blocks processing and
+ * decompression) record binary events instead of printing them, so tracing
+ * is always on. Each event is an event type Id and up to four arguments,
+ * the record is a few stores to a preallocated ring, the slot is claimed with
+ * an atomic increment, so no locking is required. The ring is rendered to a
+ * readable form only on data loading failure, in verbose mode or on request
+ * (see trace_dump()).
+ */
+
+#define TRACE_RING_SZ		1024	/* Events, should be a power of 2 */
+
+enum trace_ev {
+	TRACE_EV_LOAD_START,		/* source */
+	TRACE_EV_LOAD_DONE,		/* source, result */
+	TRACE_EV_RAW_READ,		/* source, length */
+	TRACE_EV_EEP_MAGIC,		/* byteswapped */
+	TRACE_EV_EEP_SIZE,		/* detected size, words */
+	TRACE_EV_9300_ACCESS,		/* source, address */
+	TRACE_EV_9300_BLOCK,		/* addr, comp, ref, len|maj<<12|min<<16 */
+	TRACE_EV_9300_BAD_LEN,		/* address, length */
+	TRACE_EV_9300_BAD_CSUM,		/* address, got csum, expected csum */
+	TRACE_EV_9300_RESTORE_NONE,	/* block, length */
+	TRACE_EV_9300_RESTORE_BLOCK,	/* block, reference, length */
+	TRACE_EV_9300_RESTORE_RUN,	/* position, spot, offset, length */
+};
+
+/* Data source, for loading events */
+enum trace_src {
+	TRACE_SRC_RAW_EEPROM,
+	TRACE_SRC_RAW_OTP,
+	TRACE_SRC_BLOB,
+	TRACE_SRC_EEPROM,
+	TRACE_SRC_OTP,
+};
+
+struct trace_ent {
+	uint32_t ev;
+	uint32_t arg[4];
+};
+
+extern struct trace_ent trace_ring[TRACE_RING_SZ];
+extern unsigned int trace_head;		/* Total number of events */
+
+extern const char * const trace_src_names[];
+
+static inline void trace_event(enum trace_ev ev, uint32_t a0, uint32_t a1,
+			       uint32_t a2, uint32_t a3)
+{
+	unsigned int pos = __atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED);
+	struct trace_ent *ent = &trace_ring[pos & (TRACE_RING_SZ - 1)];
+
+	ent->ev = ev;
+	ent->arg[0] = a0;
+	ent->arg[1] = a1;
+	ent->arg[2] = a2;
+	ent->arg[3] = a3;
+}
+
+#define __TRACE(__ev, __a0, __a1, __a2, __a3, ...)			\
+		trace_event(__ev, __a0, __a1, __a2, __a3)
+#define TRACE(__ev, ...)						\
+		__TRACE(TRACE_EV_ ## __ev, ##__VA_ARGS__, 0, 0, 0, 0)
+
+void trace_mark(void);
+void trace_dump(FILE *fp, bool all);
+
+#endif /* TRACE_H */
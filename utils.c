@@ -17,6 +17,8 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
 
 #include "utils.h"
 
@@ -50,3 +52,57 @@ void hexdump_print(const void *buf, int len)
 		printf("|\n");
 	}
 }
+
+/**
+ * Count number of differing bytes in two buffers. Buffers are compared by
+ * machine words: XOR of two words gives a non-zero octet for each differing
+ * byte, then each non-zero octet is folded into its least significant bit and
+ * these bits are counted at once. Counting is stopped as soon as the number of
+ * differences exceeds the bound, so caller will got any value above the bound
+ * in this case.
+ */
+size_t memdiff(const void *a, const void *b, size_t len, size_t bound)
+{
+	const uint8_t *pa = a, *pb = b;
+	size_t diff = 0, i = 0;
+	uint64_t wa, wb, x;
+
+	for (; i + sizeof(x) <= len; i += sizeof(x)) {
+		memcpy(&wa, pa + i, sizeof(wa));	/* Unaligned safe load */
+		memcpy(&wb, pb + i, sizeof(wb));
+		x = wa ^ wb;
+		if (!x)
+			continue;
+		x |= x >> 4;
+		x |= x >> 2;
+		x |= x >> 1;
+		x &= 0x0101010101010101ULL;
+		diff += __builtin_popcountll(x);
+		if (diff > bound)
+			return diff;
+	}
+
+	for (; i < len; ++i)
+		diff += pa[i] != pb[i];
+
+	return diff;
+}
+
+/**
+ * Split a string into whitespace separated tokens, returns tokens number or
+ * -E2BIG if the string contains more than <max> tokens.
+ */
+int str_split(char *str, char *argv[], int max)
+{
+	char *tok, *saveptr;
+	int argc = 0;
+
+	for (tok = strtok_r(str, " \t\r\n", &saveptr); tok;
+	     tok = strtok_r(NULL, " \t\r\n", &saveptr)) {
+		if (argc == max)
+			return -E2BIG;
+		argv[argc++] = tok;
+	}
+
+	return argc;
+}
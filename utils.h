@@ -18,6 +18,7 @@
 #define UTILS_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 static inline int macaddr_is_valid(const uint8_t *mac)
 {
@@ -31,7 +32,22 @@ static inline int macaddr_is_valid(const uint8_t *mac)
 	return 1;
 }
 
+/* See: https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2 */
+static inline uint32_t roundup_pow_of_2(uint32_t v)
+{
+	v--;
+	v |= v >> 1;
+	v |= v >> 2;
+	v |= v >> 4;
+	v |= v >> 8;
+	v |= v >> 16;
+
+	return v + 1;
+}
+
 int macaddr_parse(const char *str, uint8_t *out);
 void hexdump_print(const void *buf, int len);
+size_t memdiff(const void *a, const void *b, size_t len, size_t bound);
+int str_split(char *str, char *argv[], int max);
 
 #endif	/* UTILS_H */
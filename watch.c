@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2021 Sergey Ryazanov <ryazanov.s.a@gmail.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <signal.h>
+#include <time.h>
+
+#include "atheepmgr.h"
+
+/**
+ * Registers and GPIO lines sampler. Items are sampled periodically with
+ * absolute deadlines, so a sampling period does not drift with the sampling
+ * duration. Only changes are recorded to a ring buffer, which is allocated
+ * before sampling starts, so the oldest records are overwritten if the ring
+ * is overflowed. Records are dumped on exit and on SIGUSR1 reception.
+ */
+
+#define WATCH_ITEMS_MAX		16
+#define WATCH_ITEM_GPIO		UINT32_MAX	/* Pseudo address of GPIO inputs */
+
+#define NSEC_PER_SEC		1000000000ULL
+
+struct watch_rec {
+	uint64_t ts;		/* Nanoseconds since sampling start */
+	uint32_t val;
+	uint16_t item;
+};
+
+struct watch {
+	uint32_t items[WATCH_ITEMS_MAX];
+	uint32_t last[WATCH_ITEMS_MAX];
+	unsigned int nitems;
+	struct watch_rec *ring;
+	size_t ring_sz;
+	size_t head;		/* Next record position */
+	uint64_t nrecs;		/* Total number of records */
+	uint64_t nsamples;
+	uint64_t overruns;	/* Number of missed deadlines */
+	uint64_t max_late;	/* Max wakeup lateness, ns */
+};
+
+static volatile sig_atomic_t watch_stop;
+static volatile sig_atomic_t watch_dump_req;
+
+static void watch_sighandler(int signum)
+{
+	if (signum == SIGUSR1)
+		watch_dump_req = 1;
+	else
+		watch_stop = 1;
+}
+
+static uint64_t watch_ts2ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static void watch_ns2ts(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NSEC_PER_SEC;
+	ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+static uint32_t watch_item_read(struct atheepmgr *aem, uint32_t item)
+{
+	if (item != WATCH_ITEM_GPIO)
+		return REG_READ(item);
+
+	return aem->gpio->inputs_get(aem);	/* Single register read */
+}
+
+static void watch_sample(struct atheepmgr *aem, struct watch *w, uint64_t ts)
+{
+	struct watch_rec *rec;
+	uint32_t val;
+	unsigned int i;
+
+	for (i = 0; i < w->nitems; ++i) {
+		val = watch_item_read(aem, w->items[i]);
+		if (w->nsamples && val == w->last[i])
+			continue;
+		w->last[i] = val;
+		rec = &w->ring[w->head];
+		rec->ts = ts;
+		rec->val = val;
+		rec->item = i;
+		w->head = (w->head + 1) % w->ring_sz;
+		w->nrecs++;
+	}
+	w->nsamples++;
+}
+
+static void watch_dump(const struct watch *w)
+{
+	const struct watch_rec *rec;
+	size_t i, n, start;
+
+	n = w->nrecs < w->ring_sz ? w->nrecs : w->ring_sz;
+	start = (w->head + w->ring_sz - n) % w->ring_sz;
+
+	for (i = 0; i < n; ++i) {
+		rec = &w->ring[(start + i) % w->ring_sz];
+		printf("%6llu.%09llu ",
+		       (unsigned long long)(rec->ts / NSEC_PER_SEC),
+		       (unsigned long long)(rec->ts % NSEC_PER_SEC));
+		if (w->items[rec->item] == WATCH_ITEM_GPIO)
+			printf("%10s", "gpio");
+		else
+			printf("0x%08x", w->items[rec->item]);
+		printf(": 0x%08x\n", rec->val);
+	}
+
+	printf("Samples: %llu, changes: %llu (lost %llu), missed deadlines: %llu, max lateness: %llu us\n",
+	       (unsigned long long)w->nsamples,
+	       (unsigned long long)w->nrecs,
+	       (unsigned long long)(w->nrecs - n),
+	       (unsigned long long)w->overruns,
+	       (unsigned long long)(w->max_late / 1000));
+	fflush(stdout);
+}
+
+static int watch_parse_item(struct atheepmgr *aem, struct watch *w,
+			    const char *str)
+{
+	unsigned long addr;
+	char *endp;
+
+	if (w->nitems >= WATCH_ITEMS_MAX) {
+		fprintf(stderr, "Too many items to watch, at most %d are supported\n",
+			WATCH_ITEMS_MAX);
+		return -EINVAL;
+	}
+
+	if (strcmp(str, "gpio") == 0) {
+		if (!aem->gpio) {
+			fprintf(stderr, "GPIO control is not supported for this chip, aborting\n");
+			return -EOPNOTSUPP;
+		}
+		w->items[w->nitems++] = WATCH_ITEM_GPIO;
+		return 0;
+	}
+
+	errno = 0;
+	addr = strtoul(str, &endp, 16);
+	if (errno != 0 || *endp != '\0' || addr % 4 != 0 ||
+	    addr >= WATCH_ITEM_GPIO) {
+		fprintf(stderr, "Invalid register address -- %s\n", str);
+		return -EINVAL;
+	}
+	w->items[w->nitems++] = addr;
+
+	return 0;
+}
+
+int watch_run(struct atheepmgr *aem, int argc, char *argv[])
+{
+	unsigned long rate = 1000, duration = 0;
+	struct timespec now, deadline;
+	uint64_t period, start, next, stop = 0, ts;
+	struct watch w = {.ring_sz = 4096};
+	struct sigaction sa, osa_int, osa_term, osa_usr1;
+	char *endp;
+	int i, ret;
+
+	for (i = 0; i < argc; ++i) {
+		errno = 0;
+		if (strncmp(argv[i], "rate=", 5) == 0) {
+			rate = strtoul(argv[i] + 5, &endp, 10);
+			if (errno || *endp != '\0' || !rate ||
+			    rate > NSEC_PER_SEC) {
+				fprintf(stderr, "Invalid sampling rate -- %s\n",
+					argv[i] + 5);
+				return -EINVAL;
+			}
+		} else if (strncmp(argv[i], "ring=", 5) == 0) {
+			w.ring_sz = strtoul(argv[i] + 5, &endp, 10);
+			if (errno || *endp != '\0' || !w.ring_sz) {
+				fprintf(stderr, "Invalid ring size -- %s\n",
+					argv[i] + 5);
+				return -EINVAL;
+			}
+		} else if (strncmp(argv[i], "time=", 5) == 0) {
+			duration = strtoul(argv[i] + 5, &endp, 10);
+			if (errno || *endp != '\0') {
+				fprintf(stderr, "Invalid sampling duration -- %s\n",
+					argv[i] + 5);
+				return -EINVAL;
+			}
+		} else {
+			ret = watch_parse_item(aem, &w, argv[i]);
+			if (ret)
+				return ret;
+		}
+	}
+
+	if (!w.nitems) {
+		fprintf(stderr, "Nothing to watch, specify registers and/or 'gpio'\n");
+		return -EINVAL;
+	}
+
+	w.ring = calloc(w.ring_sz, sizeof(*w.ring));
+	if (!w.ring) {
+		fprintf(stderr, "Unable to allocate memory for the samples ring\n");
+		return -ENOMEM;
+	}
+
+	/* Could be called several times within a session */
+	watch_stop = 0;
+	watch_dump_req = 0;
+
+	/* No SA_RESTART, so signals are able to interrupt the sleeping */
+	memset(&sa, 0x00, sizeof(sa));
+	sa.sa_handler = watch_sighandler;
+	sigaction(SIGINT, &sa, &osa_int);
+	sigaction(SIGTERM, &sa, &osa_term);
+	sigaction(SIGUSR1, &sa, &osa_usr1);
+
+	if (aem->verbose)
+		printf("Watch %u item(s) at %lu Hz, ring of %zu records\n",
+		       w.nitems, rate, w.ring_sz);
+
+	period = NSEC_PER_SEC / rate;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	start = next = watch_ts2ns(&now);
+	if (duration)
+		stop = start + duration * NSEC_PER_SEC;
+
+	while (!watch_stop) {
+		watch_ns2ts(next, &deadline);
+		if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline,
+				    NULL) != 0)
+			continue;	/* Interrupted, recheck the stop flag */
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ts = watch_ts2ns(&now);
+		if (ts - next > w.max_late)
+			w.max_late = ts - next;
+
+		watch_sample(aem, &w, ts - start);
+
+		if (stop && ts >= stop)
+			break;
+
+		if (watch_dump_req) {
+			watch_dump_req = 0;
+			watch_dump(&w);
+		}
+
+		/* Skip missed deadlines instead of sampling in a burst */
+		next += period;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ts = watch_ts2ns(&now);
+		if (ts >= next) {
+			w.overruns += (ts - next) / period + 1;
+			next += ((ts - next) / period + 1) * period;
+		}
+	}
+
+	sigaction(SIGINT, &osa_int, NULL);
+	sigaction(SIGTERM, &osa_term, NULL);
+	sigaction(SIGUSR1, &osa_usr1, NULL);
+
+	watch_dump(&w);
+	free(w.ring);
+
+	return 0;
+}